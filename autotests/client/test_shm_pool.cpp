@@ -19,6 +19,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 // Qt
 #include <QtTest>
+#include <QRandomGenerator>
 #include <QImage>
 // KWin
 #include "../../src/client/compositor.h"
@@ -47,6 +48,9 @@ private Q_SLOTS:
     void testCreateBufferFromImageWithAlpha();
     void testCreateBufferFromData();
     void testReuseBuffer();
+    void testReuseFreedMemory();
+    void testReclaimOldestBuffer();
+    void testStatistics();
     void testDestroy();
 
 private:
@@ -222,6 +226,138 @@ void TestShmPool::testReuseBuffer()
     QVERIFY(buffer4 != buffer3);
 }
 
+void TestShmPool::testReuseFreedMemory()
+{
+    // this test verifies that the memory of released buffers gets reused when resizing often
+    QVERIFY(m_shmPool->isValid());
+    QSignalSpy poolResizedSpy(m_shmPool, &KWayland::Client::ShmPool::poolResized);
+    QVERIFY(poolResizedSpy.isValid());
+
+    QRandomGenerator generator(42);
+    const int maxSize = 256;
+    const int maxByteCount = maxSize * maxSize * 4;
+    QSharedPointer<KWayland::Client::Buffer> previous;
+    for (int i = 0; i < 10000; i++) {
+        const QSize size(generator.bounded(1, maxSize + 1), generator.bounded(1, maxSize + 1));
+        auto buffer = m_shmPool->getBuffer(size, size.width() * 4).toStrongRef();
+        QVERIFY(buffer);
+        QCOMPARE(buffer->size(), size);
+        // the server released the previous buffer after the new one got attached
+        if (previous) {
+            previous->setReleased(true);
+        }
+        previous = buffer;
+    }
+    // one buffer is in use at any time, so the free memory cannot get too fragmented
+    QVERIFY(m_shmPool->poolSize() <= 6 * maxByteCount);
+    QVERIFY(poolResizedSpy.count() < 20);
+
+    // trimming keeps the pool usable
+    previous->setReleased(true);
+    previous.clear();
+    const int32_t poolSize = m_shmPool->poolSize();
+    m_shmPool->trim();
+    QCOMPARE(m_shmPool->poolSize(), poolSize);
+    auto buffer = m_shmPool->getBuffer(QSize(64, 64), 64 * 4).toStrongRef();
+    QVERIFY(buffer);
+    QCOMPARE(m_shmPool->poolSize(), poolSize);
+}
+
+void TestShmPool::testReclaimOldestBuffer()
+{
+    // this test verifies that only as many released buffers get destroyed as needed for a new one
+    using KWayland::Client::Buffer;
+    QVERIFY(m_shmPool->isValid());
+    const int32_t poolSize = m_shmPool->poolSize();
+    QCOMPARE(poolSize, 1024);
+
+    // fill the pool with four differently sized buffers of 256 bytes each
+    auto first = m_shmPool->getBuffer(QSize(4, 16), 16).toStrongRef();
+    auto second = m_shmPool->getBuffer(QSize(16, 4), 64).toStrongRef();
+    auto third = m_shmPool->getBuffer(QSize(8, 8), 32).toStrongRef();
+    auto used = m_shmPool->getBuffer(QSize(2, 32), 8).toStrongRef();
+    QVERIFY(first);
+    QVERIFY(second);
+    QVERIFY(third);
+    QVERIFY(used);
+    QCOMPARE(m_shmPool->poolSize(), poolSize);
+
+    first->setReleased(true);
+    second->setReleased(true);
+    third->setReleased(true);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 3);
+    QWeakPointer<Buffer> firstPointer(first);
+    first.clear();
+
+    // a new size only reclaims the buffer released first
+    auto other = m_shmPool->getBuffer(QSize(32, 2), 128).toStrongRef();
+    QVERIFY(other);
+    QCOMPARE(m_shmPool->poolSize(), poolSize);
+    QVERIFY(!firstPointer.toStrongRef());
+    QCOMPARE(m_shmPool->bufferCount(), 4);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 2);
+
+    // the other released buffers are still reused
+    QCOMPARE(m_shmPool->getBuffer(QSize(16, 4), 64).toStrongRef(), second);
+    QCOMPARE(m_shmPool->getBuffer(QSize(8, 8), 32).toStrongRef(), third);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 0);
+}
+
+void TestShmPool::testStatistics()
+{
+    // this test verifies the statistics provided by the ShmPool for reused buffers
+    using KWayland::Client::Buffer;
+    QVERIFY(m_shmPool->isValid());
+    QCOMPARE(m_shmPool->bufferCount(), 0);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 0);
+    QCOMPARE(m_shmPool->wastedBytes(), m_shmPool->poolSize());
+
+    // create many differently sized buffers, e.g. cursors and icons
+    QVector<QSharedPointer<Buffer>> buffers;
+    int32_t usedBytes = 0;
+    for (int i = 1; i <= 100; i++) {
+        auto buffer = m_shmPool->getBuffer(QSize(i, i), i * 4).toStrongRef();
+        QVERIFY(buffer);
+        buffers << buffer;
+        usedBytes += i * i * 4;
+    }
+    QCOMPARE(m_shmPool->bufferCount(), 100);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 0);
+    QCOMPARE(m_shmPool->wastedBytes(), m_shmPool->poolSize() - usedBytes);
+
+    // release all buffers but mark one as used
+    for (const auto &buffer : buffers) {
+        buffer->setReleased(true);
+    }
+    buffers.at(49)->setUsed(true);
+    QCOMPARE(m_shmPool->bufferCount(), 100);
+    QCOMPARE(m_shmPool->releasedBufferCount(), 99);
+    QCOMPARE(m_shmPool->wastedBytes(), m_shmPool->poolSize() - 50 * 50 * 4);
+
+    // requesting a buffer with a matching size, stride and format reuses the released one
+    auto reused = m_shmPool->getBuffer(QSize(20, 20), 80).toStrongRef();
+    QCOMPARE(reused, buffers.at(19));
+    QVERIFY(!reused->isReleased());
+    QCOMPARE(m_shmPool->releasedBufferCount(), 98);
+    // a different format does not match
+    auto other = m_shmPool->getBuffer(QSize(30, 30), 120, Buffer::Format::RGB32).toStrongRef();
+    QVERIFY(other);
+    QVERIFY(other != buffers.at(29));
+    // the used buffer is not reused
+    auto notUsed = m_shmPool->getBuffer(QSize(50, 50), 200).toStrongRef();
+    QVERIFY(notUsed);
+    QVERIFY(notUsed != buffers.at(49));
+
+    // trim destroys all released buffers
+    buffers.clear();
+    reused.clear();
+    other.clear();
+    notUsed.clear();
+    m_shmPool->trim();
+    QCOMPARE(m_shmPool->releasedBufferCount(), 0);
+    QCOMPARE(m_shmPool->bufferCount(), 4);
+}
+
 void TestShmPool::testDestroy()
 {
     using namespace KWayland::Client;
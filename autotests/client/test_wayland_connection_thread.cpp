@@ -19,10 +19,12 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 // Qt
 #include <QtTest>
+#include <QElapsedTimer>
 // KWin
 #include "../../src/client/connection_thread.h"
 #include "../../src/client/event_queue.h"
 #include "../../src/client/registry.h"
+#include "../../src/server/compositor_interface.h"
 #include "../../src/server/display.h"
 // Wayland
 #include <wayland-client-protocol.h>
@@ -30,6 +32,12 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
+// STL
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+Q_DECLARE_METATYPE(KWayland::Client::EventQueue::DispatchMode)
 
 class TestWaylandConnectionThread : public QObject
 {
@@ -46,6 +54,10 @@ private Q_SLOTS:
     void testConnectionThread();
     void testConnectFd();
     void testConnectFdNoSocketName();
+    void testQueueDispatchLatency();
+    void testEventsReadOnQueueThread();
+    void testDirectDispatchLatency_data();
+    void testDirectDispatchLatency();
 
 private:
     KWayland::Server::Display *m_display;
@@ -297,5 +309,340 @@ void TestWaylandConnectionThread::testConnectFdNoSocketName()
     delete connectionThread;
 }
 
+static void syncDone(void *data, wl_callback *callback, uint32_t serial)
+{
+    Q_UNUSED(serial)
+    *reinterpret_cast<std::atomic<bool>*>(data) = true;
+    wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener s_syncListener = {
+    syncDone
+};
+
+namespace {
+// an EventQueue on its own thread doing sync roundtrips one after the other
+struct RoundtripQueue {
+    QThread *thread = nullptr;
+    KWayland::Client::EventQueue *queue = nullptr;
+    wl_display *wrapper = nullptr;
+    int roundtrips = 0;
+    QElapsedTimer timer;
+    QVector<qint64> latencies;
+    std::atomic<bool> finished{false};
+    void sync();
+};
+}
+
+static void roundtripDone(void *data, wl_callback *callback, uint32_t serial)
+{
+    Q_UNUSED(serial)
+    wl_callback_destroy(callback);
+    auto roundtrip = reinterpret_cast<RoundtripQueue*>(data);
+    roundtrip->latencies << roundtrip->timer.nsecsElapsed();
+    if (roundtrip->latencies.count() == roundtrip->roundtrips) {
+        roundtrip->finished = true;
+        return;
+    }
+    // flushed by EventQueue::dispatch
+    roundtrip->sync();
+}
+
+static const struct wl_callback_listener s_roundtripListener = {
+    roundtripDone
+};
+
+void RoundtripQueue::sync()
+{
+    timer.start();
+    wl_callback *callback = wl_display_sync(wrapper);
+    wl_callback_add_listener(callback, &s_roundtripListener, this);
+}
+
+void TestWaylandConnectionThread::testQueueDispatchLatency()
+{
+    // this test verifies that EventQueues on several threads read and dispatch their events
+    // while the ConnectionThread keeps reading on its own thread and measures the median roundtrip
+    // latency. The queues read the events of each other, without waking up each other they stall.
+    using namespace KWayland::Client;
+    ConnectionThread *connection = new ConnectionThread;
+    connection->setSocketName(s_socketName);
+
+    QThread *connectionThread = new QThread(this);
+    connection->moveToThread(connectionThread);
+    connectionThread->start();
+
+    QSignalSpy connectedSpy(connection, &ConnectionThread::connected);
+    QVERIFY(connectedSpy.isValid());
+    connection->initConnection();
+    QVERIFY(connectedSpy.wait());
+    wl_display *display = connection->display();
+    QVERIFY(display);
+
+    const int queueCount = 4;
+    std::vector<RoundtripQueue> queues(queueCount);
+    for (RoundtripQueue &roundtrip : queues) {
+        roundtrip.roundtrips = 200;
+        roundtrip.thread = new QThread(this);
+        roundtrip.thread->start();
+        roundtrip.queue = new EventQueue;
+        roundtrip.queue->moveToThread(roundtrip.thread);
+        QMetaObject::invokeMethod(roundtrip.queue,
+            [&roundtrip, connection, display] {
+                roundtrip.queue->setup(connection);
+                roundtrip.wrapper = reinterpret_cast<wl_display*>(wl_proxy_create_wrapper(display));
+                roundtrip.queue->addProxy(reinterpret_cast<wl_proxy*>(roundtrip.wrapper));
+                roundtrip.sync();
+                wl_display_flush(display);
+            }, Qt::QueuedConnection);
+    }
+    // the server dispatches on this thread
+    for (RoundtripQueue &roundtrip : queues) {
+        QTRY_VERIFY_WITH_TIMEOUT(roundtrip.finished.load(), 30000);
+    }
+    QVector<qint64> latencies;
+    for (RoundtripQueue &roundtrip : queues) {
+        QMetaObject::invokeMethod(roundtrip.queue,
+            [&roundtrip] {
+                wl_proxy_wrapper_destroy(roundtrip.wrapper);
+                delete roundtrip.queue;
+            }, Qt::BlockingQueuedConnection);
+        roundtrip.thread->quit();
+        roundtrip.thread->wait();
+        delete roundtrip.thread;
+        QCOMPARE(roundtrip.latencies.count(), roundtrip.roundtrips);
+        latencies << roundtrip.latencies;
+    }
+    QVERIFY(!connection->hasError());
+    std::sort(latencies.begin(), latencies.end());
+    QTest::setBenchmarkResult(latencies.at(latencies.count() / 2), QTest::WalltimeNanoseconds);
+
+    connection->deleteLater();
+    connectionThread->quit();
+    connectionThread->wait();
+    delete connectionThread;
+}
+
+void TestWaylandConnectionThread::testEventsReadOnQueueThread()
+{
+    // this test verifies that the events an EventQueue reads on its thread for the default queue
+    // and another EventQueue get dispatched, although the socket does not become readable for them
+    using namespace KWayland::Client;
+    ConnectionThread *connection = new ConnectionThread;
+    connection->setSocketName(s_socketName);
+
+    QThread *connectionThread = new QThread(this);
+    connection->moveToThread(connectionThread);
+    connectionThread->start();
+
+    QSignalSpy connectedSpy(connection, &ConnectionThread::connected);
+    QVERIFY(connectedSpy.isValid());
+    connection->initConnection();
+    QVERIFY(connectedSpy.wait());
+    wl_display *display = connection->display();
+    QVERIFY(display);
+
+    // two queued EventQueues on their own threads
+    QThread *readingThread = new QThread(this);
+    readingThread->start();
+    QThread *otherThread = new QThread(this);
+    otherThread->start();
+    EventQueue *readingQueue = new EventQueue;
+    readingQueue->moveToThread(readingThread);
+    EventQueue *otherQueue = new EventQueue;
+    otherQueue->moveToThread(otherThread);
+    wl_display *readingWrapper = nullptr;
+    wl_display *otherWrapper = nullptr;
+    QMetaObject::invokeMethod(readingQueue,
+        [readingQueue, connection, display, &readingWrapper] {
+            readingQueue->setup(connection);
+            readingWrapper = reinterpret_cast<wl_display*>(wl_proxy_create_wrapper(display));
+            readingQueue->addProxy(reinterpret_cast<wl_proxy*>(readingWrapper));
+        }, Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(otherQueue,
+        [otherQueue, connection, display, &otherWrapper] {
+            otherQueue->setup(connection);
+            otherWrapper = reinterpret_cast<wl_display*>(wl_proxy_create_wrapper(display));
+            otherQueue->addProxy(reinterpret_cast<wl_proxy*>(otherWrapper));
+        }, Qt::BlockingQueuedConnection);
+
+    // block the thread of the ConnectionThread, so that it does not read any events
+    QSemaphore blocked;
+    QSemaphore resume;
+    QMetaObject::invokeMethod(connection, [&blocked, &resume] {
+            blocked.release();
+            resume.acquire();
+        }, Qt::QueuedConnection);
+    blocked.acquire();
+
+    // the reply for the reading queue comes last, so reading it reads all other replies
+    std::atomic<bool> defaultDone{false};
+    std::atomic<bool> otherDone{false};
+    std::atomic<bool> readingDone{false};
+    wl_callback_add_listener(wl_display_sync(display), &s_syncListener, &defaultDone);
+    wl_callback_add_listener(wl_display_sync(otherWrapper), &s_syncListener, &otherDone);
+    wl_callback_add_listener(wl_display_sync(readingWrapper), &s_syncListener, &readingDone);
+    wl_display_flush(display);
+
+    // the events are read on the thread of the reading queue
+    for (int i = 0; i < 100 && !readingDone; ++i) {
+        QTest::qWait(10);
+        QMetaObject::invokeMethod(readingQueue, "dispatch", Qt::BlockingQueuedConnection);
+    }
+    QVERIFY(readingDone);
+    QVERIFY(!defaultDone);
+    QVERIFY(!otherDone);
+
+    // the ConnectionThread dispatches the default queue and wakes up the other queue
+    resume.release();
+    QTRY_VERIFY(defaultDone);
+    QTRY_VERIFY(otherDone);
+    QVERIFY(!connection->hasError());
+
+    QMetaObject::invokeMethod(readingQueue,
+        [readingQueue, readingWrapper] {
+            wl_proxy_wrapper_destroy(readingWrapper);
+            delete readingQueue;
+        }, Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(otherQueue,
+        [otherQueue, otherWrapper] {
+            wl_proxy_wrapper_destroy(otherWrapper);
+            delete otherQueue;
+        }, Qt::BlockingQueuedConnection);
+    readingThread->quit();
+    readingThread->wait();
+    delete readingThread;
+    otherThread->quit();
+    otherThread->wait();
+    delete otherThread;
+
+    connection->deleteLater();
+    connectionThread->quit();
+    connectionThread->wait();
+    delete connectionThread;
+}
+
+struct GlobalAnnouncements {
+    QElapsedTimer timer;
+    std::atomic<int> count{0};
+    std::atomic<qint64> time{0};
+};
+
+static void latencyRegistryHandleGlobal(void *data, struct wl_registry *registry,
+                                        uint32_t name, const char *interface, uint32_t version)
+{
+    Q_UNUSED(registry)
+    Q_UNUSED(name)
+    Q_UNUSED(interface)
+    Q_UNUSED(version)
+    auto announcements = reinterpret_cast<GlobalAnnouncements*>(data);
+    announcements->time = announcements->timer.nsecsElapsed();
+    announcements->count++;
+}
+
+static const struct wl_registry_listener s_latencyRegistryListener = {
+    latencyRegistryHandleGlobal,
+    registryHandleGlobalRemove
+};
+
+void TestWaylandConnectionThread::testDirectDispatchLatency_data()
+{
+    QTest::addColumn<KWayland::Client::EventQueue::DispatchMode>("mode");
+
+    QTest::newRow("queued") << KWayland::Client::EventQueue::DispatchMode::Queued;
+    QTest::newRow("direct") << KWayland::Client::EventQueue::DispatchMode::Direct;
+}
+
+void TestWaylandConnectionThread::testDirectDispatchLatency()
+{
+    // this test measures the median time from the server sending an event till the handler on an
+    // EventQueue in its own thread gets invoked while the ConnectionThread reads as well, so that
+    // either thread might read the event first, and verifies that the direct mode does not depend
+    // on the eventsRead signal of the ConnectionThread
+    using namespace KWayland::Client;
+    ConnectionThread *connection = new ConnectionThread;
+    connection->setSocketName(s_socketName);
+
+    QThread *connectionThread = new QThread(this);
+    connection->moveToThread(connectionThread);
+    connectionThread->start();
+
+    QSignalSpy connectedSpy(connection, &ConnectionThread::connected);
+    QVERIFY(connectedSpy.isValid());
+    connection->initConnection();
+    QVERIFY(connectedSpy.wait());
+    wl_display *display = connection->display();
+    QVERIFY(display);
+
+    QThread *queueThread = new QThread(this);
+    queueThread->start();
+    EventQueue *queue = new EventQueue;
+    queue->moveToThread(queueThread);
+    QFETCH(EventQueue::DispatchMode, mode);
+    GlobalAnnouncements announcements;
+    announcements.timer.start();
+    wl_registry *registry = nullptr;
+    QMetaObject::invokeMethod(queue,
+        [queue, connection, mode, display, &registry, &announcements] {
+            queue->setup(connection, mode);
+            // create the registry through a wrapper, so that no event gets dispatched on the default queue
+            auto wrapper = reinterpret_cast<wl_display*>(wl_proxy_create_wrapper(display));
+            queue->addProxy(reinterpret_cast<wl_proxy*>(wrapper));
+            registry = wl_display_get_registry(wrapper);
+            wl_proxy_wrapper_destroy(wrapper);
+            wl_registry_add_listener(registry, &s_latencyRegistryListener, &announcements);
+            wl_display_flush(display);
+        }, Qt::BlockingQueuedConnection);
+    QCOMPARE(queue->dispatchMode(), mode);
+    // the shm global
+    QTRY_COMPARE(announcements.count.load(), 1);
+
+    QVector<qint64> latencies;
+    for (int i = 0; i < 50; ++i) {
+        const qint64 sent = announcements.timer.nsecsElapsed();
+        QScopedPointer<KWayland::Server::CompositorInterface> compositor(m_display->createCompositor());
+        compositor->create();
+        QTRY_COMPARE(announcements.count.load(), i + 2);
+        latencies << announcements.time - sent;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    QTest::setBenchmarkResult(latencies.at(latencies.count() / 2), QTest::WalltimeNanoseconds);
+
+    // block the thread of the ConnectionThread, so that it neither reads nor emits eventsRead
+    QSemaphore blocked;
+    QSemaphore resume;
+    QMetaObject::invokeMethod(connection, [&blocked, &resume] {
+            blocked.release();
+            resume.acquire();
+        }, Qt::QueuedConnection);
+    blocked.acquire();
+    QScopedPointer<KWayland::Server::CompositorInterface> compositor(m_display->createCompositor());
+    compositor->create();
+    if (mode == EventQueue::DispatchMode::Direct) {
+        // the direct mode reads and dispatches on the thread of the EventQueue
+        QTRY_COMPARE(announcements.count.load(), 52);
+    } else {
+        // the queued mode waits for the ConnectionThread
+        QTest::qWait(100);
+        QCOMPARE(announcements.count.load(), 51);
+    }
+    resume.release();
+    QTRY_COMPARE(announcements.count.load(), 52);
+
+    QMetaObject::invokeMethod(queue,
+        [queue, &registry] {
+            wl_registry_destroy(registry);
+            delete queue;
+        }, Qt::BlockingQueuedConnection);
+    queueThread->quit();
+    queueThread->wait();
+    delete queueThread;
+
+    connection->deleteLater();
+    connectionThread->quit();
+    connectionThread->wait();
+    delete connectionThread;
+}
+
 QTEST_GUILESS_MAIN(TestWaylandConnectionThread)
 #include "test_wayland_connection_thread.moc"
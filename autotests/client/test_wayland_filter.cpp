@@ -49,6 +49,7 @@ private Q_SLOTS:
     void cleanup();
     void testFilter_data();
     void testFilter();
+    void testFilterCache();
 
 private:
     TestDisplay *m_display;
@@ -66,6 +67,7 @@ public:
     TestDisplay(QObject *parent);
     bool allowInterface(KWayland::Server::ClientConnection * client, const QByteArray & interfaceName) override;
     QList<wl_client*> m_allowedClients;
+    int m_allowInterfaceCalls = 0;
 };
 
 TestDisplay::TestDisplay(QObject *parent):
@@ -74,6 +76,7 @@ TestDisplay::TestDisplay(QObject *parent):
 
 bool TestDisplay::allowInterface(KWayland::Server::ClientConnection* client, const QByteArray& interfaceName)
 {
+    m_allowInterfaceCalls++;
     if (interfaceName == "org_kde_kwin_blur_manager") {
         return m_allowedClients.contains(*client);
     }
@@ -163,6 +166,61 @@ void TestFilter::testFilter()
     thread->wait();
 }
 
+void TestFilter::testFilterCache()
+{
+    // this test verifies that the filter result is cached per client till it gets invalidated
+    QScopedPointer<KWayland::Client::ConnectionThread> connection(new KWayland::Client::ConnectionThread());
+    QSignalSpy connectedSpy(connection.data(), &ConnectionThread::connected);
+    QVERIFY(connectedSpy.isValid());
+    connection->setSocketName(s_socketName);
+
+    QScopedPointer<QThread> thread(new QThread(this));
+    connection->moveToThread(thread.data());
+    thread->start();
+
+    connection->initConnection();
+    QVERIFY(connectedSpy.wait());
+
+    KWayland::Client::EventQueue queue;
+    queue.setup(connection.data());
+
+    auto blurAnnounced = [&queue, &connection] {
+        Registry registry;
+        QSignalSpy registryDoneSpy(&registry, &Registry::interfacesAnnounced);
+        QSignalSpy blurSpy(&registry, &Registry::blurAnnounced);
+        registry.setEventQueue(&queue);
+        registry.create(connection->display());
+        registry.setup();
+        registryDoneSpy.wait();
+        return blurSpy.count() == 1;
+    };
+
+    QVERIFY(!blurAnnounced());
+    const int calls = m_display->m_allowInterfaceCalls;
+    QVERIFY(calls > 0);
+    QCOMPARE(m_display->connections().count(), 1);
+    auto clientConnection = m_display->connections().first();
+
+    // another registry of the same client uses the cached results
+    QVERIFY(!blurAnnounced());
+    QCOMPARE(m_display->m_allowInterfaceCalls, calls);
+
+    // a changed policy only applies once the cache is invalidated
+    m_display->m_allowedClients << clientConnection->client();
+    QVERIFY(!blurAnnounced());
+    QCOMPARE(m_display->m_allowInterfaceCalls, calls);
+    m_display->invalidateInterfaceFilter(clientConnection);
+    QVERIFY(blurAnnounced());
+    QCOMPARE(m_display->m_allowInterfaceCalls, calls * 2);
+
+    m_display->m_allowedClients.clear();
+    m_display->invalidateInterfaceFilter();
+    QVERIFY(!blurAnnounced());
+    QCOMPARE(m_display->m_allowInterfaceCalls, calls * 3);
+
+    thread->quit();
+    thread->wait();
+}
 
 QTEST_GUILESS_MAIN(TestFilter)
 #include "test_wayland_filter.moc"
@@ -28,6 +28,9 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "../../src/server/display.h"
 #include "../../src/server/compositor_interface.h"
 #include "../../src/server/region_interface.h"
+// STL
+#include <memory>
+#include <vector>
 
 class TestRegion : public QObject
 {
@@ -45,6 +48,8 @@ private Q_SLOTS:
     void testRemove();
     void testDestroy();
     void testDisconnect();
+    void testLookupManyRegions();
+    void testDestroyManyRegions();
 
 private:
     KWayland::Server::Display *m_display;
@@ -315,5 +320,64 @@ void TestRegion::testDisconnect()
     m_queue->destroy();
 }
 
+void TestRegion::testLookupManyRegions()
+{
+    // this test creates a large number of regions and verifies that looking them up and
+    // destroying them does not depend on the number of live resources
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    const int count = 100000;
+    QVector<RegionInterface*> serverRegions;
+    serverRegions.reserve(count);
+    connect(m_compositorInterface, &CompositorInterface::regionCreated, this,
+        [&serverRegions] (RegionInterface *r) {
+            serverRegions << r;
+        }
+    );
+    std::vector<std::unique_ptr<Region>> regions;
+    regions.reserve(count);
+    for (int i = 0; i < count; i++) {
+        regions.emplace_back(m_compositor->createRegion());
+    }
+    m_connection->flush();
+    QTRY_COMPARE_WITH_TIMEOUT(serverRegions.count(), count, 60000);
+
+    QBENCHMARK {
+        for (RegionInterface *r : qAsConst(serverRegions)) {
+            QCOMPARE(RegionInterface::get(r->resource()), r);
+        }
+    }
+}
+
+void TestRegion::testDestroyManyRegions()
+{
+    // this test verifies that destroying a large number of regions does not depend on the
+    // number of live resources
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    const int count = 100000;
+    int created = 0;
+    int destroyed = 0;
+    connect(m_compositorInterface, &CompositorInterface::regionCreated, this,
+        [this, &created, &destroyed] (RegionInterface *r) {
+            created++;
+            connect(r, &QObject::destroyed, this, [&destroyed] { destroyed++; });
+        }
+    );
+    std::vector<std::unique_ptr<Region>> regions;
+    regions.reserve(count);
+    for (int i = 0; i < count; i++) {
+        regions.emplace_back(m_compositor->createRegion());
+    }
+    m_connection->flush();
+    QTRY_COMPARE_WITH_TIMEOUT(created, count, 60000);
+
+    QBENCHMARK_ONCE {
+        regions.clear();
+        m_connection->flush();
+        QTRY_COMPARE_WITH_TIMEOUT(destroyed, count, 60000);
+    }
+}
+
 QTEST_GUILESS_MAIN(TestRegion)
 #include "test_wayland_region.moc"
@@ -55,6 +55,11 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 // System
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+// STL
+#include <atomic>
+#include <functional>
+#include <thread>
 
 class TestWaylandSeat : public QObject
 {
@@ -69,11 +74,20 @@ private Q_SLOTS:
     void testCapabilities_data();
     void testCapabilities();
     void testPointer();
+    void testPointerMotionOtherClients_data();
+    void testPointerMotionOtherClients();
+    void testPointerMotionBacklog();
+    void testTouchMotionBacklog();
+    void testRelativePointerMotion();
+    void testInputFrame();
+    void testInputQueue();
     void testPointerTransformation_data();
     void testPointerTransformation();
     void testPointerButton_data();
     void testPointerButton();
     void testPointerSubSurfaceTree();
+    void testPointerMotionTransformed_data();
+    void testPointerMotionTransformed();
     void testPointerSwipeGesture_data();
     void testPointerSwipeGesture();
     void testPointerPinchGesture_data();
@@ -82,12 +96,16 @@ private Q_SLOTS:
     void testCursor();
     void testCursorDamage();
     void testKeyboard();
+    void testKeyboardStorm();
+    void testSharedKeymap();
     void testCast();
     void testDestroy();
     void testSelection();
     void testSelectionNoDataSource();
     void testDataDeviceForKeyboardSurface();
     void testTouch();
+    void testTouchMultiPoint();
+    void testTouchPointerEmulation();
     void testDisconnect();
     void testPointerEnterOnUnboundSurface();
     // TODO: add test for keymap
@@ -617,6 +635,558 @@ void TestWaylandSeat::testPointer()
     QVERIFY(!m_seatInterface->focusedPointer());
 }
 
+void TestWaylandSeat::testPointerMotionOtherClients_data()
+{
+    QTest::addColumn<int>("pointerCount");
+
+    QTest::newRow("0") << 0;
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+}
+
+void TestWaylandSeat::testPointerMotionOtherClients()
+{
+    // this test verifies that the cost of pointer motion does not depend on the pointers of not focused clients
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(pointerSpy.wait());
+
+    // create a second Wayland client connection which binds many pointers
+    auto c = new ConnectionThread;
+    QSignalSpy connectedSpy(c, &ConnectionThread::connected);
+    QVERIFY(connectedSpy.isValid());
+    c->setSocketName(s_socketName);
+
+    auto thread = new QThread(this);
+    c->moveToThread(thread);
+    thread->start();
+
+    c->initConnection();
+    QVERIFY(connectedSpy.wait());
+
+    QScopedPointer<EventQueue> queue(new EventQueue);
+    queue->setup(c);
+
+    QScopedPointer<Registry> registry(new Registry);
+    QSignalSpy interfacesAnnouncedSpy(registry.data(), &Registry::interfacesAnnounced);
+    QVERIFY(interfacesAnnouncedSpy.isValid());
+    registry->setEventQueue(queue.data());
+    registry->create(c);
+    QVERIFY(registry->isValid());
+    registry->setup();
+    QVERIFY(interfacesAnnouncedSpy.wait());
+    QScopedPointer<Seat> seat(registry->createSeat(registry->interface(Registry::Interface::Seat).name,
+                                                   registry->interface(Registry::Interface::Seat).version));
+    QVERIFY(seat->isValid());
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QFETCH(int, pointerCount);
+    for (int i = 0; i < pointerCount; i++) {
+        QVERIFY(seat->createPointer(seat.data())->isValid());
+    }
+    while (pointerCreatedSpy.count() < pointerCount) {
+        QVERIFY(pointerCreatedSpy.wait());
+    }
+
+    // the focused surface belongs to the first client
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> surface(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    QScopedPointer<Pointer> p(m_seat->createPointer());
+    QVERIFY(p->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QCOMPARE(pointerCreatedSpy.count(), pointerCount + 1);
+    m_seatInterface->setFocusedPointerSurface(serverSurface);
+    QCOMPARE(m_seatInterface->focusedPointer(), pointerCreatedSpy.last().first().value<PointerInterface*>());
+
+    QSignalSpy motionSpy(p.data(), &Pointer::motion);
+    QVERIFY(motionSpy.isValid());
+    int i = 0;
+    QBENCHMARK {
+        m_seatInterface->setPointerPos(QPointF(i % 100, (i / 100) % 100));
+        i++;
+    }
+    QVERIFY(motionSpy.wait());
+
+    // and delete the connection thread again
+    seat.reset();
+    registry.reset();
+    queue.reset();
+    c->deleteLater();
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+void TestWaylandSeat::testPointerMotionBacklog()
+{
+    // this test verifies that a client which does not read its connection only gets the latest pointer position
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(pointerSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QScopedPointer<Pointer> p(m_seat->createPointer());
+    QVERIFY(p->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QSignalSpy enteredSpy(p.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    QSignalSpy motionSpy(p.data(), &Pointer::motion);
+    QVERIFY(motionSpy.isValid());
+    QSignalSpy buttonSpy(p.data(), &Pointer::buttonStateChanged);
+    QVERIFY(buttonSpy.isValid());
+    QPointF buttonPos;
+    connect(p.data(), &Pointer::buttonStateChanged, this,
+        [&buttonPos, &motionSpy] {
+            buttonPos = motionSpy.last().first().toPointF();
+        }
+    );
+    m_seatInterface->setPointerPos(QPointF(0, 0));
+    m_seatInterface->setFocusedPointerSurface(serverSurface);
+    QVERIFY(enteredSpy.wait());
+    auto client = m_seatInterface->focusedPointer()->client();
+
+    // block the thread of the client connection, so that it does not read any events
+    QSemaphore blocked;
+    QSemaphore resume;
+    QMetaObject::invokeMethod(m_connection, [&blocked, &resume] {
+            blocked.release();
+            resume.acquire();
+        }, Qt::QueuedConnection);
+    blocked.acquire();
+
+    int x = 0;
+    while (client->unreadBytes() <= 32 * 1024 && x < 100000) {
+        m_seatInterface->setPointerPos(QPointF(++x % 100, 1));
+        client->flush();
+    }
+    QVERIFY(client->unreadBytes() > 32 * 1024);
+
+    // the backlogged client does not get any further motion events
+    const quint64 sent = m_seatInterface->inputEventsSent();
+    for (int i = 1; i <= 1000; ++i) {
+        m_seatInterface->setPointerPos(QPointF(i % 100, 2));
+        client->flush();
+    }
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent);
+
+    // but a button is sent at the latest position
+    m_seatInterface->setPointerPos(QPointF(50, 50));
+    m_seatInterface->pointerButtonPressed(Qt::LeftButton);
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent + 2);
+    m_seatInterface->setPointerPos(QPointF(60, 60));
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent + 2);
+
+    // let the client read again
+    resume.release();
+    QVERIFY(buttonSpy.wait());
+    QCOMPARE(buttonPos, QPointF(50, 50));
+    // the held back position is sent once the client caught up
+    QTRY_COMPARE(m_seatInterface->inputEventsSent(), sent + 3);
+    QTRY_COMPARE(motionSpy.last().first().toPointF(), QPointF(60, 60));
+    m_seatInterface->pointerButtonReleased(Qt::LeftButton);
+    QVERIFY(buttonSpy.wait());
+    m_seatInterface->setFocusedPointerSurface(nullptr);
+}
+
+void TestWaylandSeat::testTouchMotionBacklog()
+{
+    // this test verifies that a client which does not read its connection only gets the latest
+    // touch position together with a single frame
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy touchSpy(m_seat, &Seat::hasTouchChanged);
+    QVERIFY(touchSpy.isValid());
+    m_seatInterface->setHasTouch(true);
+    QVERIFY(touchSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy touchCreatedSpy(m_seatInterface, &SeatInterface::touchCreated);
+    QVERIFY(touchCreatedSpy.isValid());
+    QScopedPointer<Touch> touch(m_seat->createTouch());
+    QVERIFY(touch->isValid());
+    QVERIFY(touchCreatedSpy.wait());
+    m_seatInterface->setFocusedTouchSurface(serverSurface);
+    QVERIFY(m_seatInterface->focusedTouch());
+    QSignalSpy frameEndedSpy(touch.data(), &Touch::frameEnded);
+    QVERIFY(frameEndedSpy.isValid());
+    QStringList events;
+    QPointF lastPosition;
+    connect(touch.data(), &Touch::pointMoved, this,
+        [&events, &lastPosition] (TouchPoint *point) {
+            events << QStringLiteral("moved");
+            lastPosition = point->position();
+        }
+    );
+    connect(touch.data(), &Touch::frameEnded, this,
+        [&events] {
+            events << QStringLiteral("frame");
+        }
+    );
+
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), 0);
+    m_seatInterface->touchFrame();
+    QVERIFY(frameEndedSpy.wait());
+    auto client = m_seatInterface->focusedTouch()->client();
+
+    // block the thread of the client connection, so that it does not read any events
+    QSemaphore blocked;
+    QSemaphore resume;
+    QMetaObject::invokeMethod(m_connection, [&blocked, &resume] {
+            blocked.release();
+            resume.acquire();
+        }, Qt::QueuedConnection);
+    blocked.acquire();
+
+    int x = 0;
+    while (client->unreadBytes() <= 32 * 1024 && x < 100000) {
+        m_seatInterface->touchMove(0, QPointF(++x % 100, 1));
+        m_seatInterface->touchFrame();
+        client->flush();
+    }
+    QVERIFY(client->unreadBytes() > 32 * 1024);
+
+    // the backlogged client neither gets further motion nor frames
+    const quint64 sent = m_seatInterface->inputEventsSent();
+    for (int i = 1; i <= 100; ++i) {
+        m_seatInterface->touchMove(0, QPointF(i, 2));
+        m_seatInterface->touchFrame();
+        client->flush();
+    }
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent);
+
+    // let the client read again, it gets the latest position with one frame
+    resume.release();
+    QTRY_COMPARE(lastPosition, QPointF(100, 2));
+    QTRY_COMPARE(events.last(), QStringLiteral("frame"));
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent + 1);
+    for (int i = 1; i < events.count(); ++i) {
+        // no empty frame
+        QVERIFY(events.at(i) != QStringLiteral("frame") || events.at(i - 1) != QStringLiteral("frame"));
+    }
+
+    m_seatInterface->touchUp(0);
+    m_seatInterface->touchFrame();
+    QVERIFY(frameEndedSpy.wait());
+}
+
+void TestWaylandSeat::testRelativePointerMotion()
+{
+    // this test verifies the delivery of relative motion to relative pointers created after the focus change,
+    // the accumulation of deltas for a backlogged client and measures high rate relative motion
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(pointerSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QScopedPointer<Pointer> p(m_seat->createPointer());
+    QVERIFY(p->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QSignalSpy enteredSpy(p.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    m_seatInterface->setFocusedPointerSurface(serverSurface);
+    QVERIFY(enteredSpy.wait());
+
+    // the relative pointer gets created while the pointer is focused
+    QScopedPointer<RelativePointer> relativePointer(m_relativePointerManager->createRelativePointer(p.data()));
+    QVERIFY(relativePointer->isValid());
+    QSignalSpy relativeMotionSpy(relativePointer.data(), &RelativePointer::relativeMotion);
+    QVERIFY(relativeMotionSpy.isValid());
+    m_connection->flush();
+    QTest::qWait(100);
+    m_seatInterface->relativePointerMotion(QSizeF(1, 2), QSizeF(3, 4), quint64(1));
+    QVERIFY(relativeMotionSpy.wait());
+    QCOMPARE(relativeMotionSpy.count(), 1);
+    QCOMPARE(relativeMotionSpy.last().at(0).toSizeF(), QSizeF(1, 2));
+
+    // block the thread of the client connection, so that it does not read any events
+    auto client = m_seatInterface->focusedPointer()->client();
+    QSemaphore blocked;
+    QSemaphore resume;
+    QMetaObject::invokeMethod(m_connection, [&blocked, &resume] {
+            blocked.release();
+            resume.acquire();
+        }, Qt::QueuedConnection);
+    blocked.acquire();
+    quint64 time = 1;
+    while (client->unreadBytes() <= 32 * 1024 && time < 100000) {
+        m_seatInterface->relativePointerMotion(QSizeF(1, 1), QSizeF(1, 1), ++time);
+        client->flush();
+    }
+    QVERIFY(client->unreadBytes() > 32 * 1024);
+    const int received = relativeMotionSpy.count() + time - 1;
+
+    // the deltas are accumulated while the client is backlogged
+    const quint64 sent = m_seatInterface->inputEventsSent();
+    for (int i = 0; i < 100; ++i) {
+        m_seatInterface->relativePointerMotion(QSizeF(1, 2), QSizeF(3, 4), ++time);
+        client->flush();
+    }
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent);
+    resume.release();
+    QTRY_COMPARE(relativeMotionSpy.count(), received + 1);
+    QCOMPARE(relativeMotionSpy.last().at(0).toSizeF(), QSizeF(100, 200));
+    QCOMPARE(relativeMotionSpy.last().at(1).toSizeF(), QSizeF(300, 400));
+    QCOMPARE(relativeMotionSpy.last().at(2).value<quint64>(), time);
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            m_seatInterface->relativePointerMotion(QSizeF(1, 0), QSizeF(1, 0), ++time);
+        }
+        client->flush();
+    }
+
+    // no more relative motion once the relative pointer is gone
+    relativePointer.reset();
+    m_connection->flush();
+    QTest::qWait(100);
+    const quint64 sentWithoutRelativePointer = m_seatInterface->inputEventsSent();
+    m_seatInterface->relativePointerMotion(QSizeF(1, 2), QSizeF(3, 4), ++time);
+    QCOMPARE(m_seatInterface->inputEventsSent(), sentWithoutRelativePointer);
+    m_seatInterface->setFocusedPointerSurface(nullptr);
+}
+
+void TestWaylandSeat::testInputFrame()
+{
+    // this test verifies that pointer events inside an input frame get coalesced
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(pointerSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> surface(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QScopedPointer<Pointer> p(m_seat->createPointer());
+    QVERIFY(p->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QSignalSpy enteredSpy(p.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    m_seatInterface->setPointerPos(QPointF(10, 10));
+    m_seatInterface->setFocusedPointerSurface(serverSurface);
+    QVERIFY(enteredSpy.wait());
+
+    QStringList events;
+    connect(p.data(), &Pointer::motion, this,
+        [&events] (const QPointF &pos) {
+            events << QStringLiteral("motion %1,%2").arg(pos.x()).arg(pos.y());
+        }
+    );
+    connect(p.data(), &Pointer::axisChanged, this,
+        [&events] (quint32 time, Pointer::Axis axis, qreal delta) {
+            Q_UNUSED(time)
+            Q_UNUSED(axis)
+            events << QStringLiteral("axis %1").arg(delta);
+        }
+    );
+    connect(p.data(), &Pointer::buttonStateChanged, this,
+        [&events] {
+            events << QStringLiteral("button");
+        }
+    );
+    connect(p.data(), &Pointer::frame, this,
+        [&events] {
+            events << QStringLiteral("frame");
+        }
+    );
+    QSignalSpy frameSpy(p.data(), &Pointer::frame);
+    QVERIFY(frameSpy.isValid());
+
+    // motion and axis get coalesced
+    const quint64 received = m_seatInterface->inputEventsReceived();
+    const quint64 sent = m_seatInterface->inputEventsSent();
+    QVERIFY(!m_seatInterface->isInputFrame());
+    m_seatInterface->beginInputFrame();
+    QVERIFY(m_seatInterface->isInputFrame());
+    m_seatInterface->setPointerPos(QPointF(11, 10));
+    m_seatInterface->setPointerPos(QPointF(12, 10));
+    m_seatInterface->setPointerPos(QPointF(13, 11));
+    m_seatInterface->pointerAxis(Qt::Vertical, 5);
+    m_seatInterface->pointerAxis(Qt::Vertical, 5);
+    // a nested input frame does not send anything
+    m_seatInterface->beginInputFrame();
+    m_seatInterface->setPointerPos(QPointF(14, 12));
+    m_seatInterface->endInputFrame();
+    QVERIFY(m_seatInterface->isInputFrame());
+    m_seatInterface->endInputFrame();
+    QVERIFY(!m_seatInterface->isInputFrame());
+    QVERIFY(frameSpy.wait());
+    QCOMPARE(events, QStringList({QStringLiteral("motion 14,12"), QStringLiteral("axis 10"), QStringLiteral("frame")}));
+    QCOMPARE(m_seatInterface->inputEventsReceived(), received + 6);
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent + 2);
+
+    // buttons keep their order relative to the motion
+    events.clear();
+    m_seatInterface->beginInputFrame();
+    m_seatInterface->setPointerPos(QPointF(15, 12));
+    m_seatInterface->setPointerPos(QPointF(16, 12));
+    m_seatInterface->pointerButtonPressed(BTN_LEFT);
+    m_seatInterface->setPointerPos(QPointF(17, 12));
+    m_seatInterface->setPointerPos(QPointF(18, 12));
+    m_seatInterface->pointerButtonReleased(BTN_LEFT);
+    m_seatInterface->endInputFrame();
+    QVERIFY(frameSpy.wait());
+    QCOMPARE(events, QStringList({QStringLiteral("motion 16,12"), QStringLiteral("button"),
+                                  QStringLiteral("motion 18,12"), QStringLiteral("button"),
+                                  QStringLiteral("frame")}));
+    QCOMPARE(m_seatInterface->inputEventsReceived(), received + 12);
+    QCOMPARE(m_seatInterface->inputEventsSent(), sent + 6);
+
+    // without an input frame each event gets its own frame
+    events.clear();
+    m_seatInterface->setPointerPos(QPointF(19, 12));
+    m_seatInterface->setPointerPos(QPointF(20, 12));
+    QVERIFY(frameSpy.wait());
+    if (frameSpy.count() < 4) {
+        QVERIFY(frameSpy.wait());
+    }
+    QCOMPARE(events, QStringList({QStringLiteral("motion 19,12"), QStringLiteral("frame"),
+                                  QStringLiteral("motion 20,12"), QStringLiteral("frame")}));
+}
+
+void TestWaylandSeat::testInputQueue()
+{
+    // this test verifies that events pushed into the input queue from another thread are delivered
+    // in order without loss while the server event loop is busy
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(pointerSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QScopedPointer<Pointer> p(m_seat->createPointer());
+    QVERIFY(p->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QSignalSpy enteredSpy(p.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    m_seatInterface->setFocusedPointerSurface(serverSurface);
+    QVERIFY(enteredSpy.wait());
+    QSignalSpy motionSpy(p.data(), &Pointer::motion);
+    QVERIFY(motionSpy.isValid());
+    QSignalSpy buttonSpy(p.data(), &Pointer::buttonStateChanged);
+    QVERIFY(buttonSpy.isValid());
+    QStringList events;
+    connect(p.data(), &Pointer::buttonStateChanged, this, [&events] { events << QStringLiteral("button"); });
+    connect(p.data(), &Pointer::frame, this, [&events] { events << QStringLiteral("frame"); });
+
+    // out of range touch ids are rejected
+    QVERIFY(!m_seatInterface->queueTouchDown(-1, QPointF(), 0));
+    QVERIFY(!m_seatInterface->queueTouchDown(64, QPointF(), 0));
+
+    const quint32 clicks = 3000;
+    std::atomic<bool> done{false};
+    std::thread producer([this, &done, clicks] {
+        auto push = [] (const std::function<bool()> &queue) {
+            while (!queue()) {
+                // the queue is full, wait for the Display thread to drain it
+                std::this_thread::yield();
+            }
+        };
+        for (quint32 i = 0; i < clicks; ++i) {
+            push([this, i] { return m_seatInterface->queuePointerPos(QPointF(i % 100, 10), i * 2); });
+            push([this, i] { return m_seatInterface->queuePointerButtonPressed(BTN_LEFT, i * 2); });
+            push([this] { return m_seatInterface->queueFrame(); });
+            push([this, i] { return m_seatInterface->queuePointerButtonReleased(BTN_LEFT, i * 2 + 1); });
+            push([this] { return m_seatInterface->queueFrame(); });
+        }
+        done = true;
+    });
+    while (!done) {
+        // simulate a slow frame blocking the server event loop
+        QThread::msleep(5);
+        QCoreApplication::processEvents();
+    }
+    producer.join();
+
+    QTRY_COMPARE_WITH_TIMEOUT(buttonSpy.count(), int(clicks * 2), 10000);
+    for (int i = 0; i < buttonSpy.count(); ++i) {
+        QCOMPARE(buttonSpy.at(i).at(1).value<quint32>(), quint32(i));
+        QCOMPARE(buttonSpy.at(i).at(2).value<quint32>(), quint32(BTN_LEFT));
+        QCOMPARE(buttonSpy.at(i).at(3).value<Pointer::ButtonState>(), i % 2 ? Pointer::ButtonState::Released : Pointer::ButtonState::Pressed);
+    }
+    QVERIFY(!motionSpy.isEmpty());
+    QCOMPARE(motionSpy.last().first().toPointF(), QPointF((clicks - 1) % 100, 10));
+    QCOMPARE(m_seatInterface->pointerPos(), QPointF((clicks - 1) % 100, 10));
+    QVERIFY(!m_seatInterface->isPointerButtonPressed(BTN_LEFT));
+    QVERIFY(!m_seatInterface->isInputFrame());
+    // the frames of the producer are kept, press and release never share a frame
+    QTRY_COMPARE(events.count(), int(clicks * 4));
+    for (int i = 0; i < events.count(); i += 2) {
+        QCOMPARE(events.at(i), QStringLiteral("button"));
+        QCOMPARE(events.at(i + 1), QStringLiteral("frame"));
+    }
+
+    // events can be dispatched right away, but only complete frames
+    QVERIFY(m_seatInterface->queuePointerButtonPressed(BTN_RIGHT, clicks * 2));
+    m_seatInterface->dispatchQueuedInput();
+    QVERIFY(!m_seatInterface->isPointerButtonPressed(BTN_RIGHT));
+    QVERIFY(m_seatInterface->queueFrame());
+    m_seatInterface->dispatchQueuedInput();
+    QVERIFY(m_seatInterface->isPointerButtonPressed(BTN_RIGHT));
+    QCOMPARE(m_seatInterface->timestamp(), clicks * 2);
+    QVERIFY(m_seatInterface->queuePointerButtonReleased(BTN_RIGHT, clicks * 2 + 1));
+    QVERIFY(m_seatInterface->queueFrame());
+    QTRY_VERIFY(!m_seatInterface->isPointerButtonPressed(BTN_RIGHT));
+    m_seatInterface->setFocusedPointerSurface(nullptr);
+}
+
 void TestWaylandSeat::testPointerTransformation_data()
 {
     QTest::addColumn<QMatrix4x4>("enterTransformation");
@@ -915,6 +1485,98 @@ void TestWaylandSeat::testPointerSubSurfaceTree()
     QCOMPARE(pointer->enteredSurface(), parentSurface.data());
 }
 
+void TestWaylandSeat::testPointerMotionTransformed_data()
+{
+    QTest::addColumn<QMatrix4x4>("transformation");
+
+    QMatrix4x4 translation;
+    translation.translate(-10, -20);
+    QMatrix4x4 scale;
+    scale.scale(2, 2);
+    scale.translate(-5, 0);
+    QMatrix4x4 shear;
+    shear(0, 1) = 0.5;
+
+    QTest::newRow("identity") << QMatrix4x4();
+    QTest::newRow("translation") << translation;
+    QTest::newRow("scale") << scale;
+    QTest::newRow("general") << shear;
+}
+
+void TestWaylandSeat::testPointerMotionTransformed()
+{
+    // this test verifies the pointer motion on a sub-surface for the different kinds of transformations
+    // and measures the dispatch of motion events
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy hasPointerChangedSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(hasPointerChangedSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    QVERIFY(hasPointerChangedSpy.wait());
+    QScopedPointer<Pointer> pointer(m_seat->createPointer());
+
+    // parent surface (100, 100) with a sub surface (50, 100) which has a child (50, 50) at (0, 25)
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> parentSurface(m_compositor->createSurface());
+    QScopedPointer<Surface> childSurface(m_compositor->createSurface());
+    QScopedPointer<Surface> grandChildSurface(m_compositor->createSurface());
+    QScopedPointer<SubSurface> childSubSurface(m_subCompositor->createSubSurface(childSurface.data(), parentSurface.data()));
+    QScopedPointer<SubSurface> grandChildSubSurface(m_subCompositor->createSubSurface(grandChildSurface.data(), childSurface.data()));
+    grandChildSubSurface->setPosition(QPoint(0, 25));
+
+    auto render = [this] (Surface *s, const QSize &size) {
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::black);
+        s->attachBuffer(m_shm->createBuffer(image));
+        s->damage(QRect(QPoint(0, 0), size));
+        s->commit(Surface::CommitFlag::None);
+    };
+    render(grandChildSurface.data(), QSize(50, 50));
+    render(childSurface.data(), QSize(50, 100));
+    render(parentSurface.data(), QSize(100, 100));
+
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface->isMapped());
+
+    QSignalSpy enteredSpy(pointer.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    QSignalSpy motionSpy(pointer.data(), &Pointer::motion);
+    QVERIFY(motionSpy.isValid());
+
+    QFETCH(QMatrix4x4, transformation);
+    const QMatrix4x4 inverted = transformation.inverted();
+    m_seatInterface->setPointerPos(inverted.map(QPointF(25, 50)));
+    m_seatInterface->setFocusedPointerSurface(serverSurface, transformation);
+    QVERIFY(enteredSpy.wait());
+    QCOMPARE(pointer->enteredSurface(), grandChildSurface.data());
+    QCOMPARE(enteredSpy.last().last().toPointF(), QPointF(25, 25));
+
+    m_seatInterface->setPointerPos(inverted.map(QPointF(25, 70)));
+    QVERIFY(motionSpy.wait());
+    QCOMPARE(motionSpy.last().first().toPointF(), QPointF(25, 45));
+
+    // moving the sub-surface changes the position in the sub-surface
+    QSignalSpy treeChangedSpy(serverSurface, &SurfaceInterface::subSurfaceTreeChanged);
+    QVERIFY(treeChangedSpy.isValid());
+    grandChildSubSurface->setPosition(QPoint(0, 35));
+    childSurface->commit(Surface::CommitFlag::None);
+    parentSurface->commit(Surface::CommitFlag::None);
+    QVERIFY(treeChangedSpy.wait());
+    m_seatInterface->setPointerPos(inverted.map(QPointF(25, 71)));
+    QVERIFY(motionSpy.wait());
+    QCOMPARE(pointer->enteredSurface(), grandChildSurface.data());
+    QCOMPARE(motionSpy.last().first().toPointF(), QPointF(25, 36));
+
+    int i = 0;
+    QBENCHMARK {
+        m_seatInterface->setPointerPos(inverted.map(QPointF(10 + i++ % 30, 60)));
+    }
+    m_seatInterface->setFocusedPointerSurface(nullptr);
+}
+
 void TestWaylandSeat::testPointerSwipeGesture_data()
 {
     QTest::addColumn<bool>("cancel");
@@ -1546,6 +2208,16 @@ void TestWaylandSeat::testKeyboard()
     QVERIFY(keyChangedSpy.wait());
     QCOMPARE(keyChangedSpy.count(), 7);
 
+    // the first release of a key never seen pressed is forwarded, e.g. held while the compositor started
+    m_seatInterface->keyReleased(KEY_F3);
+    QVERIFY(keyChangedSpy.wait());
+    QCOMPARE(keyChangedSpy.count(), 8);
+    QCOMPARE(keyChangedSpy.last().at(0).value<quint32>(), quint32(KEY_F3));
+    QCOMPARE(keyChangedSpy.last().at(1).value<Keyboard::KeyState>(), Keyboard::KeyState::Released);
+    // but not a second one
+    m_seatInterface->keyReleased(KEY_F3);
+    QVERIFY(!keyChangedSpy.wait(200));
+
     m_seatInterface->updateKeyboardModifiers(1, 2, 3, 4);
     QVERIFY(modifierSpy.wait());
     QCOMPARE(modifierSpy.count(), 2);
@@ -1650,6 +2322,124 @@ void TestWaylandSeat::testKeyboard()
     QCOMPARE(m_seatInterface->focusedKeyboardSurface(), serverSurface);
 }
 
+void TestWaylandSeat::testKeyboardStorm()
+{
+    // this test verifies the pressed key tracking while a lot of keys are pressed and focus changes often
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy keyboardSpy(m_seat, &Seat::hasKeyboardChanged);
+    QVERIFY(keyboardSpy.isValid());
+    m_seatInterface->setHasKeyboard(true);
+    QVERIFY(keyboardSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s1(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    QScopedPointer<Surface> s2(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface1 = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    SurfaceInterface *serverSurface2 = surfaceCreatedSpy.last().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface1);
+    QVERIFY(serverSurface2);
+
+    QScopedPointer<Keyboard> keyboard(m_seat->createKeyboard());
+    QVERIFY(keyboard->isValid());
+    wl_display_flush(m_connection->display());
+    QTest::qWait(100);
+
+    // pressed keys are reported in the order of pressing, out of range codes are not tracked
+    m_seatInterface->keyPressed(KEY_K);
+    m_seatInterface->keyPressed(KEY_A);
+    m_seatInterface->keyPressed(0x1000);
+    QCOMPARE(m_seatInterface->pressedKeys(), QVector<quint32>({KEY_K, KEY_A}));
+    m_seatInterface->keyReleased(KEY_K);
+    m_seatInterface->keyReleased(0x1000);
+    QCOMPARE(m_seatInterface->pressedKeys(), QVector<quint32>({KEY_A}));
+    m_seatInterface->keyReleased(KEY_A);
+    QVERIFY(m_seatInterface->pressedKeys().isEmpty());
+
+    QBENCHMARK {
+        for (quint32 i = 0; i < 1000; ++i) {
+            m_seatInterface->setTimestamp(i);
+            m_seatInterface->keyPressed(KEY_ESC + i % 100);
+            if (i % 10 == 0) {
+                m_seatInterface->setFocusedKeyboardSurface(i % 20 ? serverSurface1 : serverSurface2);
+            }
+            m_seatInterface->keyReleased(KEY_ESC + (i + 50) % 100);
+        }
+        for (quint32 i = 0; i < 100; ++i) {
+            m_seatInterface->keyReleased(KEY_ESC + i);
+        }
+        QVERIFY(m_seatInterface->pressedKeys().isEmpty());
+        m_seatInterface->focusedKeyboard()->client()->flush();
+    }
+    m_seatInterface->setFocusedKeyboardSurface(nullptr);
+}
+
+void TestWaylandSeat::testSharedKeymap()
+{
+    // this test verifies that a keymap set as content is shared read-only and cached
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy keyboardSpy(m_seat, &Seat::hasKeyboardChanged);
+    QVERIFY(keyboardSpy.isValid());
+    m_seatInterface->setHasKeyboard(true);
+    QVERIFY(keyboardSpy.wait());
+
+    const QByteArray us = QByteArrayLiteral("xkb_keymap { us };");
+    const QByteArray de = QByteArrayLiteral("xkb_keymap { de };");
+    m_seatInterface->setKeymap(us);
+    QVERIFY(m_seatInterface->isKeymapXkbCompatible());
+    QCOMPARE(m_seatInterface->keymapSize(), quint32(us.size() + 1));
+    const int usFd = m_seatInterface->keymapFileDescriptor();
+    QVERIFY(usFd != -1);
+
+    // a new keyboard gets the keymap announced
+    QScopedPointer<Keyboard> keyboard(m_seat->createKeyboard());
+    QSignalSpy keymapChangedSpy(keyboard.data(), &Keyboard::keymapChanged);
+    QVERIFY(keymapChangedSpy.isValid());
+    QVERIFY(keymapChangedSpy.wait());
+    QCOMPARE(keymapChangedSpy.count(), 1);
+    int fd = keymapChangedSpy.first().first().toInt();
+    quint32 size = keymapChangedSpy.first().last().value<quint32>();
+    QCOMPARE(size, quint32(us.size() + 1));
+    // the client may only read the keymap
+    QCOMPARE(fcntl(fd, F_GETFL) & O_ACCMODE, O_RDONLY);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    QVERIFY(data != MAP_FAILED);
+    QCOMPARE(QByteArray(reinterpret_cast<const char*>(data)), us);
+    munmap(data, size);
+    close(fd);
+
+    // setting the same keymap again does not announce it again
+    m_seatInterface->setKeymap(us);
+    QCOMPARE(m_seatInterface->keymapFileDescriptor(), usFd);
+    QVERIFY(!keymapChangedSpy.wait(100));
+
+    m_seatInterface->setKeymap(de);
+    QVERIFY(m_seatInterface->keymapFileDescriptor() != usFd);
+    QCOMPARE(m_seatInterface->keymapSize(), quint32(de.size() + 1));
+    QVERIFY(keymapChangedSpy.wait());
+    QCOMPARE(keymapChangedSpy.count(), 2);
+    fd = keymapChangedSpy.last().first().toInt();
+    size = keymapChangedSpy.last().last().value<quint32>();
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    QVERIFY(data != MAP_FAILED);
+    QCOMPARE(QByteArray(reinterpret_cast<const char*>(data)), de);
+    munmap(data, size);
+    close(fd);
+
+    // switching back to a known layout reuses the file
+    m_seatInterface->setKeymap(us);
+    QCOMPARE(m_seatInterface->keymapFileDescriptor(), usFd);
+    QVERIFY(keymapChangedSpy.wait());
+    QCOMPARE(keymapChangedSpy.count(), 3);
+    close(keymapChangedSpy.last().first().toInt());
+}
+
 void TestWaylandSeat::testCast()
 {
     using namespace KWayland::Client;
@@ -2199,6 +2989,200 @@ void TestWaylandSeat::testTouch()
     QCOMPARE(m_seatInterface->focusedTouchSurface(), serverSurface);
 }
 
+void TestWaylandSeat::testTouchMultiPoint()
+{
+    // this test verifies the touch point id recycling and the batched touch motion with 10 contacts
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy touchSpy(m_seat, &Seat::hasTouchChanged);
+    QVERIFY(touchSpy.isValid());
+    m_seatInterface->setHasTouch(true);
+    QVERIFY(touchSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy touchCreatedSpy(m_seatInterface, &SeatInterface::touchCreated);
+    QVERIFY(touchCreatedSpy.isValid());
+    QScopedPointer<Touch> touch(m_seat->createTouch());
+    QVERIFY(touch->isValid());
+    QVERIFY(touchCreatedSpy.wait());
+    m_seatInterface->setFocusedTouchSurface(serverSurface);
+    QVERIFY(m_seatInterface->focusedTouch());
+
+    QSignalSpy sequenceStartedSpy(touch.data(), &Touch::sequenceStarted);
+    QVERIFY(sequenceStartedSpy.isValid());
+    QSignalSpy pointAddedSpy(touch.data(), &Touch::pointAdded);
+    QVERIFY(pointAddedSpy.isValid());
+    QSignalSpy frameEndedSpy(touch.data(), &Touch::frameEnded);
+    QVERIFY(frameEndedSpy.isValid());
+
+    for (qint32 i = 0; i < 10; ++i) {
+        QCOMPARE(m_seatInterface->touchDown(QPointF(i * 10, 0)), i);
+    }
+    m_seatInterface->touchFrame();
+    QVERIFY(frameEndedSpy.wait());
+    QCOMPARE(sequenceStartedSpy.count(), 1);
+    QCOMPARE(pointAddedSpy.count(), 9);
+    QVERIFY(m_seatInterface->isTouchSequence());
+
+    // ids increase within a sequence, a lifted id is not reused right away
+    m_seatInterface->touchUp(3);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(30, 0)), 10);
+    m_seatInterface->touchUp(5);
+    m_seatInterface->touchUp(2);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(20, 0)), 11);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(50, 0)), 12);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(100, 0)), 13);
+    m_seatInterface->touchUp(13);
+    // unknown ids are ignored
+    m_seatInterface->touchMove(42, QPointF(1, 1));
+    m_seatInterface->touchUp(42);
+    m_seatInterface->touchFrame();
+    QVERIFY(frameEndedSpy.wait());
+
+    // moving all contacts at once results in a single frame
+    QSignalSpy touchMovedSpy(m_seatInterface, &SeatInterface::touchMoved);
+    QVERIFY(touchMovedSpy.isValid());
+    const int frames = frameEndedSpy.count();
+    const QVector<qint32> ids{0, 1, 4, 6, 7, 8, 9, 10, 11, 12};
+    QVector<QPair<qint32, QPointF>> points;
+    for (qint32 id : ids) {
+        points << qMakePair(id, QPointF(id * 10, 5));
+    }
+    m_seatInterface->touchMove(points);
+    QCOMPARE(touchMovedSpy.count(), 10);
+    QVERIFY(frameEndedSpy.wait());
+    QCOMPARE(frameEndedSpy.count(), frames + 1);
+    int downPoints = 0;
+    const auto sequence = touch->sequence();
+    for (auto point : sequence) {
+        if (!point->isDown()) {
+            continue;
+        }
+        downPoints++;
+        QCOMPARE(point->position().y(), 5.0);
+    }
+    QCOMPARE(downPoints, 10);
+
+    qreal y = 5;
+    QBENCHMARK {
+        y += 1;
+        for (auto it = points.begin(); it != points.end(); ++it) {
+            it->second.setY(y);
+        }
+        m_seatInterface->touchMove(points);
+    }
+
+    // once the last slot is taken the lowest free id but the first one gets reused
+    for (qint32 id = 13; id < 64; ++id) {
+        QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), id);
+    }
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), 2);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), 3);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), 5);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), -1);
+    m_seatInterface->touchUp(0);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), -1);
+
+    for (qint32 id = 1; id < 64; ++id) {
+        m_seatInterface->touchUp(id);
+    }
+    QVERIFY(!m_seatInterface->isTouchSequence());
+    m_seatInterface->touchFrame();
+    // a new sequence starts with the first id again
+    QCOMPARE(m_seatInterface->touchDown(QPointF(0, 0)), 0);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(10, 0)), 1);
+    m_seatInterface->touchFrame();
+    QVERIFY(frameEndedSpy.wait());
+
+    // lifting a touch point in an input frame sends the motion of all touch points first
+    QStringList events;
+    connect(touch.data(), &Touch::pointMoved, this,
+        [&events] (TouchPoint *point) {
+            events << QStringLiteral("moved %1").arg(point->id());
+        }
+    );
+    connect(touch.data(), &Touch::pointRemoved, this,
+        [&events] (TouchPoint *point) {
+            events << QStringLiteral("removed %1").arg(point->id());
+        }
+    );
+    m_seatInterface->beginInputFrame();
+    m_seatInterface->touchMove(0, QPointF(0, 5));
+    m_seatInterface->touchMove(1, QPointF(10, 5));
+    m_seatInterface->touchUp(1);
+    m_seatInterface->touchFrame();
+    m_seatInterface->endInputFrame();
+    QVERIFY(frameEndedSpy.wait());
+    QCOMPARE(events, QStringList({QStringLiteral("moved 0"), QStringLiteral("moved 1"), QStringLiteral("removed 1")}));
+
+    m_seatInterface->touchUp(0);
+    m_seatInterface->touchFrame();
+}
+
+void TestWaylandSeat::testTouchPointerEmulation()
+{
+    // this test verifies that a client without wl_touch gets the first touch point of a sequence
+    // as a single pointer button press, even if the first touch point is lifted before the others
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+
+    QSignalSpy pointerSpy(m_seat, &Seat::hasPointerChanged);
+    QVERIFY(pointerSpy.isValid());
+    m_seatInterface->setHasPointer(true);
+    m_seatInterface->setHasTouch(true);
+    QVERIFY(pointerSpy.wait());
+
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    SurfaceInterface *serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+
+    QSignalSpy pointerCreatedSpy(m_seatInterface, &SeatInterface::pointerCreated);
+    QVERIFY(pointerCreatedSpy.isValid());
+    QScopedPointer<Pointer> pointer(m_seat->createPointer());
+    QVERIFY(pointer->isValid());
+    QVERIFY(pointerCreatedSpy.wait());
+    QSignalSpy enteredSpy(pointer.data(), &Pointer::entered);
+    QVERIFY(enteredSpy.isValid());
+    QSignalSpy buttonStateChangedSpy(pointer.data(), &Pointer::buttonStateChanged);
+    QVERIFY(buttonStateChangedSpy.isValid());
+
+    // no wl_touch is bound
+    m_seatInterface->setFocusedTouchSurface(serverSurface);
+    QVERIFY(!m_seatInterface->focusedTouch());
+
+    QCOMPARE(m_seatInterface->touchDown(QPointF(10, 10)), 0);
+    QCOMPARE(m_seatInterface->touchDown(QPointF(20, 20)), 1);
+    m_seatInterface->touchUp(0);
+    // the next touch point must not take over the pointer emulation
+    QCOMPARE(m_seatInterface->touchDown(QPointF(30, 30)), 2);
+    m_seatInterface->touchUp(1);
+    m_seatInterface->touchUp(2);
+    QVERIFY(!m_seatInterface->isTouchSequence());
+
+    QVERIFY(buttonStateChangedSpy.wait());
+    while (buttonStateChangedSpy.count() < 2) {
+        QVERIFY(buttonStateChangedSpy.wait());
+    }
+    // make sure no further events are on the way
+    QVERIFY(!buttonStateChangedSpy.wait(100));
+    QCOMPARE(enteredSpy.count(), 1);
+    QCOMPARE(enteredSpy.first().last().toPointF(), QPointF(10, 10));
+    QCOMPARE(buttonStateChangedSpy.count(), 2);
+    QCOMPARE(buttonStateChangedSpy.at(0).at(2).value<quint32>(), quint32(BTN_LEFT));
+    QCOMPARE(buttonStateChangedSpy.at(0).at(3).value<Pointer::ButtonState>(), Pointer::ButtonState::Pressed);
+    QCOMPARE(buttonStateChangedSpy.at(1).at(3).value<Pointer::ButtonState>(), Pointer::ButtonState::Released);
+}
+
 void TestWaylandSeat::testDisconnect()
 {
     // this test verifies that disconnecting the client cleans up correctly
@@ -59,6 +59,7 @@ private Q_SLOTS:
     void testRemoveSurface();
     void testMappingOfSurfaceTree();
     void testSurfaceAt();
+    void testSurfaceAtLargeTree();
     void testDestroyAttachedBuffer();
     void testDestroyParentSurface();
 
@@ -1028,6 +1029,105 @@ void TestSubSurface::testSurfaceAt()
     QVERIFY(!parentServerSurface->surfaceAt(QPointF(101, 101)));
 }
 
+void TestSubSurface::testSurfaceAtLargeTree()
+{
+    // this test simulates 1000 Hz pointer motion over a surface with 200 sub-surfaces
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QSignalSpy serverSurfaceCreated(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(serverSurfaceCreated.isValid());
+    QScopedPointer<Surface> parent(m_compositor->createSurface());
+    QImage image(QSize(1000, 1000), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::red);
+    parent->attachBuffer(m_shm->createBuffer(image));
+    parent->damage(QRect(0, 0, 1000, 1000));
+    parent->commit(Surface::CommitFlag::None);
+    QVERIFY(serverSurfaceCreated.wait());
+    SurfaceInterface *parentServerSurface = serverSurfaceCreated.last().first().value<KWayland::Server::SurfaceInterface*>();
+    QVERIFY(parentServerSurface);
+
+    // a grid of 20x10 sub-surfaces, each of them with an input region of its left half
+    const int count = 200;
+    QImage childImage(QSize(50, 50), QImage::Format_ARGB32_Premultiplied);
+    childImage.fill(Qt::blue);
+    auto childBuffer = m_shm->createBuffer(childImage);
+    std::vector<std::unique_ptr<Surface>> children;
+    std::vector<std::unique_ptr<SubSurface>> subSurfaces;
+    for (int i = 0; i < count; i++) {
+        children.emplace_back(m_compositor->createSurface());
+        Surface *child = children.back().get();
+        subSurfaces.emplace_back(m_subCompositor->createSubSurface(child, parent.data()));
+        subSurfaces.back()->setMode(SubSurface::Mode::Desynchronized);
+        subSurfaces.back()->setPosition(QPoint((i % 20) * 50, (i / 20) * 50));
+        child->attachBuffer(childBuffer);
+        child->setInputRegion(m_compositor->createRegion(QRegion(0, 0, 25, 50)).get());
+        child->damage(QRect(0, 0, 50, 50));
+        child->commit(Surface::CommitFlag::None);
+    }
+    parent->commit(Surface::CommitFlag::None);
+    m_connection->flush();
+    QTRY_COMPARE(parentServerSurface->childSubSurfaces().count(), count);
+    QTRY_VERIFY(parentServerSurface->childSubSurfaces().last()->surface()->isMapped());
+    QTRY_COMPARE(parentServerSurface->childSubSurfaces().last()->position(), QPoint(950, 450));
+
+    SurfaceInterface *lastChild = parentServerSurface->childSubSurfaces().last()->surface().data();
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(990, 490)), lastChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(960, 490)), lastChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(990, 490)), parentServerSurface);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(990, 990)), parentServerSurface);
+
+    QBENCHMARK {
+        // one second of motion events
+        for (int i = 0; i < 1000; i++) {
+            parentServerSurface->inputSurfaceAt(QPointF(i, (i * 7) % 1000));
+        }
+    }
+
+    // the cached hit test entries follow changes of the tree
+    SurfaceInterface *firstChild = parentServerSurface->childSubSurfaces().at(0)->surface().data();
+    SurfaceInterface *secondChild = parentServerSurface->childSubSurfaces().at(1)->surface().data();
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(10, 10)), firstChild);
+
+    // moving a child
+    subSurfaces.back()->setPosition(QPoint(0, 600));
+    parent->commit(Surface::CommitFlag::None);
+    QTRY_COMPARE(parentServerSurface->surfaceAt(QPointF(10, 610)), lastChild);
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(990, 490)), parentServerSurface);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(10, 610)), lastChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(960, 490)), parentServerSurface);
+
+    // a child stacked above overlaps the one below
+    subSurfaces.at(1)->setPosition(QPoint(0, 0));
+    parent->commit(Surface::CommitFlag::None);
+    QTRY_COMPARE(parentServerSurface->surfaceAt(QPointF(10, 10)), secondChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(10, 10)), secondChild);
+
+    // restacking
+    subSurfaces.at(0)->raise();
+    parent->commit(Surface::CommitFlag::None);
+    QTRY_COMPARE(parentServerSurface->surfaceAt(QPointF(10, 10)), firstChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(10, 10)), firstChild);
+
+    // unmapping
+    children.at(0)->attachBuffer((wl_buffer*)nullptr);
+    children.at(0)->commit(Surface::CommitFlag::None);
+    QTRY_VERIFY(!firstChild->isMapped());
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(10, 10)), secondChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(10, 10)), secondChild);
+
+    // a buffer of a different size
+    QImage largeImage(QSize(100, 100), QImage::Format_ARGB32_Premultiplied);
+    largeImage.fill(Qt::green);
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(90, 690)), parentServerSurface);
+    children.back()->attachBuffer(m_shm->createBuffer(largeImage));
+    children.back()->damage(QRect(0, 0, 100, 100));
+    children.back()->commit(Surface::CommitFlag::None);
+    QTRY_COMPARE(lastChild->size(), QSize(100, 100));
+    QCOMPARE(parentServerSurface->surfaceAt(QPointF(90, 690)), lastChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(10, 690)), lastChild);
+    QCOMPARE(parentServerSurface->inputSurfaceAt(QPointF(90, 690)), parentServerSurface);
+}
+
 void TestSubSurface::testDestroyAttachedBuffer()
 {
     // this test verifies that destroying of a buffer attached to a sub-surface works
@@ -53,6 +53,7 @@ private Q_SLOTS:
     void testStaticAccessor();
     void testDamage();
     void testFrameCallback();
+    void testDisplayFrameRendered();
     void testAttachBuffer();
     void testMultipleSurfaces();
     void testOpaque();
@@ -67,6 +68,15 @@ private Q_SLOTS:
     void testOutput();
     void testDisconnect();
     void testInhibit();
+    void testBufferLookup_data();
+    void testBufferLookup();
+    void testReattachBuffer();
+    void testCommitRate();
+    void testStateSignalCost_data();
+    void testStateSignalCost();
+    void testStateCommitted();
+    void testMaxDamageRects();
+    void testDamageBuffer();
 
 private:
     KWayland::Server::Display *m_display;
@@ -341,6 +351,60 @@ void TestWaylandSurface::testFrameCallback()
     QVERIFY(!frameRenderedSpy.isEmpty());
 }
 
+void TestWaylandSurface::testDisplayFrameRendered()
+{
+    // this test verifies that Display::frameRendered sends the callbacks of several surfaces with one flush per client
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QSignalSpy serverSurfaceCreated(m_compositorInterface, SIGNAL(surfaceCreated(KWayland::Server::SurfaceInterface*)));
+    QVERIFY(serverSurfaceCreated.isValid());
+    QScopedPointer<Surface> s1(m_compositor->createSurface());
+    QVERIFY(serverSurfaceCreated.wait());
+    QScopedPointer<Surface> s2(m_compositor->createSurface());
+    QVERIFY(serverSurfaceCreated.wait());
+    QScopedPointer<Surface> s3(m_compositor->createSurface());
+    QVERIFY(serverSurfaceCreated.wait());
+    QCOMPARE(serverSurfaceCreated.count(), 3);
+    QVector<SurfaceInterface*> serverSurfaces;
+    for (const auto &args : serverSurfaceCreated) {
+        serverSurfaces << args.first().value<SurfaceInterface*>();
+    }
+
+    QSignalSpy frameRendered1Spy(s1.data(), &Surface::frameRendered);
+    QVERIFY(frameRendered1Spy.isValid());
+    QSignalSpy frameRendered2Spy(s2.data(), &Surface::frameRendered);
+    QVERIFY(frameRendered2Spy.isValid());
+    QSignalSpy frameRendered3Spy(s3.data(), &Surface::frameRendered);
+    QVERIFY(frameRendered3Spy.isValid());
+
+    // only the first two surfaces request a frame callback
+    QImage img(QSize(10, 10), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    QSignalSpy committed2Spy(serverSurfaces.at(1), &SurfaceInterface::committed);
+    QVERIFY(committed2Spy.isValid());
+    s1->attachBuffer(m_shm->createBuffer(img));
+    s1->damage(QRect(0, 0, 10, 10));
+    s1->commit();
+    s2->attachBuffer(m_shm->createBuffer(img));
+    s2->damage(QRect(0, 0, 10, 10));
+    s2->commit();
+    QVERIFY(committed2Spy.wait());
+
+    // nothing sent yet
+    QCOMPARE(m_display->frameRenderedFlushCount(), 0);
+    m_display->frameRendered(serverSurfaces, 10);
+    // all surfaces belong to the same client, so it got flushed exactly once
+    QCOMPARE(m_display->frameRenderedFlushCount(), 1);
+    QVERIFY(frameRendered2Spy.wait());
+    QCOMPARE(frameRendered1Spy.count(), 1);
+    QCOMPARE(frameRendered2Spy.count(), 1);
+    QCOMPARE(frameRendered3Spy.count(), 0);
+
+    // the callbacks are consumed, so a second frame does not flush
+    m_display->frameRendered(serverSurfaces, 20);
+    QCOMPARE(m_display->frameRenderedFlushCount(), 0);
+}
+
 void TestWaylandSurface::testAttachBuffer()
 {
     // create the surface
@@ -1172,5 +1236,468 @@ void TestWaylandSurface::testInhibit()
     QCOMPARE(inhibitsChangedSpy.count(), 4);
 }
 
+void TestWaylandSurface::testBufferLookup_data()
+{
+    QTest::addColumn<int>("liveBuffers");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void TestWaylandSurface::testBufferLookup()
+{
+    // this test verifies that looking up a BufferInterface does not depend on the number of live buffers
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    ClientConnection *client = serverSurface->client();
+
+    QFETCH(int, liveBuffers);
+    QImage img(QSize(1, 1), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    QVector<quint32> ids;
+    ids.reserve(liveBuffers);
+    for (int i = 0; i < liveBuffers; i++) {
+        wl_buffer *b = *(m_shm->createBuffer(img).data());
+        ids << wl_proxy_get_id(reinterpret_cast<wl_proxy*>(b));
+    }
+    m_connection->flush();
+    QTRY_VERIFY(client->getResource(ids.last()));
+
+    QVector<BufferInterface*> serverBuffers;
+    serverBuffers.reserve(liveBuffers);
+    for (quint32 id : qAsConst(ids)) {
+        serverBuffers << BufferInterface::get(client->getResource(id));
+    }
+    wl_resource *lookup = serverBuffers.last()->resource();
+    QBENCHMARK {
+        QCOMPARE(BufferInterface::get(lookup), serverBuffers.last());
+    }
+    qDeleteAll(serverBuffers);
+}
+
+void TestWaylandSurface::testReattachBuffer()
+{
+    // this test verifies that attaching the same wl_buffer again reuses the BufferInterface
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    QSignalSpy committedSpy(serverSurface, &SurfaceInterface::committed);
+    QVERIFY(committedSpy.isValid());
+
+    QImage img(QSize(10, 10), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    auto b1 = m_shm->createBuffer(img);
+    img.fill(Qt::red);
+    auto b2 = m_shm->createBuffer(img);
+
+    s->attachBuffer(b1);
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(committedSpy.wait());
+    BufferInterface *serverBuffer1 = serverSurface->buffer();
+    QVERIFY(serverBuffer1);
+    QVERIFY(serverBuffer1->isReferenced());
+    QCOMPARE(serverBuffer1->surface(), serverSurface);
+
+    s->attachBuffer(b2);
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(committedSpy.wait());
+    BufferInterface *serverBuffer2 = serverSurface->buffer();
+    QVERIFY(serverBuffer2 != serverBuffer1);
+    QVERIFY(!serverBuffer1->isReferenced());
+    QTRY_VERIFY(b1.data()->isReleased());
+
+    // attaching the first buffer again gives the same BufferInterface
+    b1.data()->setReleased(false);
+    s->attachBuffer(b1);
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(committedSpy.wait());
+    QCOMPARE(serverSurface->buffer(), serverBuffer1);
+    QVERIFY(serverBuffer1->isReferenced());
+    QVERIFY(!serverBuffer2->isReferenced());
+
+    // re-attaching the current buffer must not release it
+    s->attachBuffer(b1);
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(committedSpy.wait());
+    QCOMPARE(serverSurface->buffer(), serverBuffer1);
+    QVERIFY(serverBuffer1->isReferenced());
+    QVERIFY(!b1.data()->isReleased());
+
+    // attaching the buffer to a second surface keeps the surface holding it
+    QScopedPointer<Surface> s2(m_compositor->createSurface());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface2 = surfaceCreatedSpy.last().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface2);
+    QSignalSpy committed2Spy(serverSurface2, &SurfaceInterface::committed);
+    QVERIFY(committed2Spy.isValid());
+    s2->attachBuffer(b1);
+    s2->damage(QRect(0, 0, 10, 10));
+    s2->commit(Surface::CommitFlag::None);
+    QVERIFY(committed2Spy.wait());
+    QCOMPARE(serverSurface2->buffer(), serverBuffer1);
+    QCOMPARE(serverBuffer1->surface(), serverSurface);
+
+    // once no surface holds it, the next surface referencing it takes over
+    s->attachBuffer(b2);
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(committedSpy.wait());
+    s2->attachBuffer(b2);
+    s2->damage(QRect(0, 0, 10, 10));
+    s2->commit(Surface::CommitFlag::None);
+    QVERIFY(committed2Spy.wait());
+    QVERIFY(!serverBuffer1->isReferenced());
+    QCOMPARE(serverBuffer2->surface(), serverSurface);
+    s2->attachBuffer(b1);
+    s2->damage(QRect(0, 0, 10, 10));
+    s2->commit(Surface::CommitFlag::None);
+    QVERIFY(committed2Spy.wait());
+    QCOMPARE(serverBuffer1->surface(), serverSurface2);
+}
+
+void TestWaylandSurface::testCommitRate()
+{
+    // benchmarks the commit cycle of a client cycling through three buffers
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    int commits = 0;
+    connect(serverSurface, &SurfaceInterface::committed, this, [&commits] { commits++; });
+
+    QImage img(QSize(100, 100), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    const QVector<wl_buffer*> buffers{*(m_shm->createBuffer(img).data()),
+                                       *(m_shm->createBuffer(img).data()),
+                                       *(m_shm->createBuffer(img).data())};
+    const int frames = 1000;
+    QBENCHMARK {
+        commits = 0;
+        for (int i = 0; i < frames; i++) {
+            s->attachBuffer(buffers.at(i % buffers.count()));
+            s->damage(QRect(0, 0, 100, 100));
+            s->commit(Surface::CommitFlag::None);
+        }
+        m_connection->flush();
+        QTRY_COMPARE(commits, frames);
+    }
+}
+
+void TestWaylandSurface::testStateSignalCost_data()
+{
+    QTest::addColumn<bool>("stateCommitted");
+    QTest::addColumn<bool>("perStateSignals");
+
+    QTest::newRow("no receivers") << false << false;
+    QTest::newRow("stateCommitted") << true << false;
+    QTest::newRow("per state signals") << false << true;
+    QTest::newRow("both") << true << true;
+}
+
+void TestWaylandSurface::testStateSignalCost()
+{
+    // benchmarks commits changing buffer, damage, opaque and input region and scale with receivers
+    // connected either to stateCommitted or to the signals for each changed state
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    int commits = 0;
+    connect(serverSurface, &SurfaceInterface::committed, this, [&commits] { commits++; });
+    int notifications = 0;
+    QFETCH(bool, stateCommitted);
+    if (stateCommitted) {
+        connect(serverSurface, &SurfaceInterface::stateCommitted, this, [&notifications] { notifications++; });
+    }
+    QFETCH(bool, perStateSignals);
+    if (perStateSignals) {
+        auto notify = [&notifications] { notifications++; };
+        connect(serverSurface, &SurfaceInterface::damaged, this, notify);
+        connect(serverSurface, &SurfaceInterface::opaqueChanged, this, notify);
+        connect(serverSurface, &SurfaceInterface::inputChanged, this, notify);
+        connect(serverSurface, &SurfaceInterface::scaleChanged, this, notify);
+        connect(serverSurface, &SurfaceInterface::sizeChanged, this, notify);
+    }
+
+    QImage img(QSize(100, 100), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    const QVector<wl_buffer*> buffers{*(m_shm->createBuffer(img).data()),
+                                       *(m_shm->createBuffer(img).data())};
+    const std::unique_ptr<Region> opaque(m_compositor->createRegion(QRegion(0, 0, 50, 50)));
+    const std::unique_ptr<Region> input(m_compositor->createRegion(QRegion(0, 0, 20, 20)));
+    const int frames = 1000;
+    QBENCHMARK {
+        commits = 0;
+        for (int i = 0; i < frames; i++) {
+            s->attachBuffer(buffers.at(i % buffers.count()));
+            s->damage(QRect(0, 0, 10, 10));
+            s->setOpaqueRegion(opaque.get());
+            s->setInputRegion(input.get());
+            s->setScale(1 + i % 2);
+            s->commit(Surface::CommitFlag::None);
+        }
+        m_connection->flush();
+        QTRY_COMPARE(commits, frames);
+    }
+    QCOMPARE(notifications > 0, stateCommitted || perStateSignals);
+}
+
+void TestWaylandSurface::testStateCommitted()
+{
+    // this test verifies that the changes of a commit are announced in one signal
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    qRegisterMetaType<SurfaceInterface::StateChanges>();
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    QSignalSpy stateCommittedSpy(serverSurface, &SurfaceInterface::stateCommitted);
+    QVERIFY(stateCommittedSpy.isValid());
+
+    // a commit without any state
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(stateCommittedSpy.wait());
+    QCOMPARE(stateCommittedSpy.last().first().value<SurfaceInterface::StateChanges>(), SurfaceInterface::StateChanges());
+
+    // attach a buffer
+    QImage img(QSize(10, 10), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    s->attachBuffer(m_shm->createBuffer(img));
+    s->damage(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(stateCommittedSpy.wait());
+    QCOMPARE(stateCommittedSpy.last().first().value<SurfaceInterface::StateChanges>(),
+             SurfaceInterface::StateChange::Buffer | SurfaceInterface::StateChange::Damage | SurfaceInterface::StateChange::Size);
+
+    // same size buffer and an opaque region
+    s->attachBuffer(m_shm->createBuffer(img));
+    s->damage(QRect(0, 0, 5, 5));
+    s->setOpaqueRegion(m_compositor->createRegion(QRegion(0, 0, 10, 10)).get());
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(stateCommittedSpy.wait());
+    QCOMPARE(stateCommittedSpy.last().first().value<SurfaceInterface::StateChanges>(),
+             SurfaceInterface::StateChange::Buffer | SurfaceInterface::StateChange::Damage | SurfaceInterface::StateChange::Opaque);
+    QCOMPARE(serverSurface->damage(), QRegion(0, 0, 5, 5));
+    QCOMPARE(serverSurface->opaque(), QRegion(0, 0, 10, 10));
+
+    // the pending state got reset, another commit does not change anything
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(stateCommittedSpy.wait());
+    QCOMPARE(stateCommittedSpy.last().first().value<SurfaceInterface::StateChanges>(), SurfaceInterface::StateChanges());
+    QCOMPARE(serverSurface->opaque(), QRegion(0, 0, 10, 10));
+
+    // and unmapping
+    s->attachBuffer((wl_buffer*)nullptr);
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(stateCommittedSpy.wait());
+    QCOMPARE(stateCommittedSpy.last().first().value<SurfaceInterface::StateChanges>(),
+             SurfaceInterface::StateChange::Buffer | SurfaceInterface::StateChange::Unmapped);
+}
+
+void TestWaylandSurface::testMaxDamageRects()
+{
+    // this test verifies that fragmented damage collapses to the bounding rect
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    QCOMPARE(serverSurface->maxDamageRects(), 64);
+    QSignalSpy damagedSpy(serverSurface, &SurfaceInterface::damaged);
+    QVERIFY(damagedSpy.isValid());
+
+    QImage img(QSize(400, 400), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    auto b = m_shm->createBuffer(img);
+
+    // a checkerboard of 200 non-touching rects
+    QRegion fragmented;
+    for (int i = 0; i < 200; i++) {
+        fragmented += QRect((i % 20) * 20, (i / 20) * 20 + (i % 2) * 10, 5, 5);
+    }
+    QVERIFY(fragmented.rectCount() > 64);
+
+    s->attachBuffer(b);
+    s->damage(fragmented);
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->damage(), QRegion(fragmented.boundingRect()));
+    QCOMPARE(serverSurface->trackedDamage(), QRegion(fragmented.boundingRect()));
+
+    // a small number of rects is kept
+    serverSurface->resetTrackedDamage();
+    const QRegion small = QRegion(0, 0, 10, 10) + QRect(50, 50, 10, 10);
+    s->attachBuffer(b);
+    s->damage(small);
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->damage(), small);
+    QCOMPARE(serverSurface->trackedDamage(), small);
+
+    // without limit the exact region is kept
+    serverSurface->setMaxDamageRects(0);
+    QCOMPARE(serverSurface->maxDamageRects(), 0);
+    serverSurface->resetTrackedDamage();
+    s->attachBuffer(b);
+    s->damage(fragmented);
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->damage(), fragmented);
+    QCOMPARE(serverSurface->trackedDamage(), fragmented);
+
+    // overlapping and touching rects, more than get merged at once, unite to the same region
+    QRegion overlapping;
+    serverSurface->resetTrackedDamage();
+    s->attachBuffer(b);
+    for (int i = 0; i < 3000; i++) {
+        const QRect rect((i * 7) % 390, (i * 13) % 390, 3 + i % 9, 2 + i % 5);
+        overlapping += rect;
+        s->damage(rect);
+    }
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QVERIFY(overlapping.rectCount() > 64);
+    QCOMPARE(serverSurface->damage(), overlapping);
+    QCOMPARE(serverSurface->trackedDamage(), overlapping);
+}
+
+void TestWaylandSurface::testDamageBuffer()
+{
+    // this test verifies that damage in buffer coordinates gets combined with the surface damage
+    using namespace KWayland::Client;
+    using namespace KWayland::Server;
+    QScopedPointer<Surface> s(m_compositor->createSurface());
+    QCOMPARE(wl_surface_get_version(*s), 4u);
+    QSignalSpy surfaceCreatedSpy(m_compositorInterface, &CompositorInterface::surfaceCreated);
+    QVERIFY(surfaceCreatedSpy.isValid());
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface = surfaceCreatedSpy.first().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface);
+    QSignalSpy damagedSpy(serverSurface, &SurfaceInterface::damaged);
+    QVERIFY(damagedSpy.isValid());
+
+    QImage img(QSize(40, 40), QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::black);
+    auto b = m_shm->createBuffer(img);
+
+    // without scale both damages are identical
+    s->attachBuffer(b);
+    s->damageBuffer(QRect(0, 0, 10, 10));
+    s->damage(QRect(30, 30, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    const QRegion expected = QRegion(0, 0, 10, 10) + QRect(30, 30, 10, 10);
+    QCOMPARE(serverSurface->damage(), expected);
+    QCOMPARE(serverSurface->bufferDamage(), expected);
+
+    // with a scale of 2 the buffer damage maps to half the size
+    s->setScale(2);
+    s->attachBuffer(b);
+    s->damageBuffer(QRect(0, 0, 10, 10));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->size(), QSize(20, 20));
+    QCOMPARE(serverSurface->damage(), QRegion(0, 0, 5, 5));
+    QCOMPARE(serverSurface->bufferDamage(), QRegion(0, 0, 10, 10));
+
+    // an odd buffer damage rounds outwards in surface coordinates
+    s->attachBuffer(b);
+    s->damageBuffer(QRect(1, 1, 2, 2));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->damage(), QRegion(0, 0, 2, 2));
+    QCOMPARE(serverSurface->bufferDamage(), QRegion(1, 1, 2, 2));
+
+    // and the surface damage maps to the buffer
+    s->attachBuffer(b);
+    s->damage(QRect(5, 5, 5, 5));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->damage(), QRegion(5, 5, 5, 5));
+    QCOMPARE(serverSurface->bufferDamage(), QRegion(10, 10, 10, 10));
+
+    // a rotated buffer
+    QImage wide(QSize(40, 20), QImage::Format_ARGB32_Premultiplied);
+    wide.fill(Qt::black);
+    s->setScale(1);
+    wl_surface_set_buffer_transform(*s, WL_OUTPUT_TRANSFORM_90);
+    s->attachBuffer(m_shm->createBuffer(wide));
+    s->damageBuffer(QRect(0, 0, 10, 5));
+    s->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(serverSurface->transform(), OutputInterface::Transform::Rotated90);
+    QCOMPARE(serverSurface->size(), QSize(20, 40));
+    QCOMPARE(serverSurface->damage(), QRegion(15, 0, 5, 10));
+    QCOMPARE(serverSurface->bufferDamage(), QRegion(0, 0, 10, 5));
+
+    // without damage_buffer the damage gets converted to surface coordinates
+    Registry registry;
+    registry.setEventQueue(m_queue);
+    QSignalSpy allAnnounced(&registry, &Registry::interfacesAnnounced);
+    QVERIFY(allAnnounced.isValid());
+    registry.create(m_connection);
+    QVERIFY(registry.isValid());
+    registry.setup();
+    QVERIFY(allAnnounced.wait());
+    QScopedPointer<Compositor> compositor(registry.createCompositor(registry.interface(Registry::Interface::Compositor).name, 3));
+    QVERIFY(compositor->isValid());
+    QScopedPointer<Surface> s3(compositor->createSurface());
+    QCOMPARE(wl_surface_get_version(*s3), 3u);
+    QVERIFY(surfaceCreatedSpy.wait());
+    auto serverSurface3 = surfaceCreatedSpy.last().first().value<SurfaceInterface*>();
+    QVERIFY(serverSurface3);
+    QSignalSpy damaged3Spy(serverSurface3, &SurfaceInterface::damaged);
+    QVERIFY(damaged3Spy.isValid());
+    s3->setScale(2);
+    s3->attachBuffer(b);
+    s3->damageBuffer(QRect(1, 1, 2, 2));
+    s3->commit(Surface::CommitFlag::None);
+    QVERIFY(damaged3Spy.wait());
+    QCOMPARE(serverSurface3->damage(), QRegion(0, 0, 2, 2));
+
+    // with a buffer transform the whole surface gets damaged
+    s3->setScale(1);
+    s3->setBufferTransform(Output::Transform::Rotated90);
+    QCOMPARE(s3->bufferTransform(), Output::Transform::Rotated90);
+    s3->attachBuffer(m_shm->createBuffer(wide));
+    s3->damageBuffer(QRect(0, 0, 10, 5));
+    s3->commit(Surface::CommitFlag::None);
+    QVERIFY(damaged3Spy.wait());
+    QCOMPARE(serverSurface3->transform(), OutputInterface::Transform::Rotated90);
+    QCOMPARE(serverSurface3->size(), QSize(20, 40));
+    QCOMPARE(serverSurface3->damage(), QRegion(0, 0, 20, 40));
+    QCOMPARE(serverSurface3->bufferDamage(), QRegion(0, 0, 40, 20));
+}
+
 QTEST_GUILESS_MAIN(TestWaylandSurface)
 #include "test_wayland_surface.moc"
@@ -42,6 +42,8 @@ private Q_SLOTS:
     void testAddRemoveOutput();
     void testClientConnection();
     void testConnectNoSocket();
+    void testClientConnectionChurn();
+    void testFlushPolicy();
     void testOutputManagement();
     void testAutoSocketName();
 };
@@ -206,6 +208,138 @@ void TestWaylandServerDisplay::testConnectNoSocket()
     close(sv[1]);
 }
 
+void TestWaylandServerDisplay::testClientConnectionChurn()
+{
+    // this test verifies the lookup of connections while many short-lived clients connect and disconnect
+    Display display;
+    display.start(Display::StartMode::ConnectClientsOnly);
+    QVERIFY(display.isRunning());
+    QSignalSpy disconnectedSpy(&display, &Display::clientDisconnected);
+    QVERIFY(disconnectedSpy.isValid());
+
+    // some long-lived clients
+    QVector<int> fds;
+    QVector<ClientConnection*> longLived;
+    for (int i = 0; i < 100; ++i) {
+        int sv[2];
+        QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) >= 0);
+        fds << sv[1];
+        auto connection = display.createClient(sv[0]);
+        QVERIFY(connection);
+        longLived << connection;
+    }
+
+    int disconnected = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            int sv[2];
+            QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) >= 0);
+            wl_client *client = wl_client_create(display, sv[0]);
+            QVERIFY(client);
+            // the wl_client of a disconnected client might have been reused, it needs a new connection
+            ClientConnection *connection = display.getConnection(client);
+            QCOMPARE(connection->client(), client);
+            QCOMPARE(display.getConnection(client), connection);
+            wl_client_destroy(client);
+            QCOMPARE(disconnectedSpy.count(), ++disconnected);
+            close(sv[1]);
+            QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        }
+    }
+    QCOMPARE(display.connections(), longLived);
+    for (ClientConnection *connection : longLived) {
+        QCOMPARE(display.getConnection(connection->client()), connection);
+        connection->destroy();
+    }
+    QVERIFY(display.connections().isEmpty());
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+void TestWaylandServerDisplay::testFlushPolicy()
+{
+    // this test verifies that deferred flushes are done once per dispatch cycle and that the
+    // events only reach the socket of the client at the end of the dispatch cycle
+    Display display;
+    display.start(Display::StartMode::ConnectClientsOnly);
+    QVERIFY(display.isRunning());
+    QCOMPARE(display.flushPolicy(), Display::FlushPolicy::Immediate);
+
+    // on a seqpacket socket each write of the server arrives as a record of its own
+    int sv[2];
+    QVERIFY(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) >= 0);
+    auto connection = display.createClient(sv[0]);
+    QVERIFY(connection);
+    // a resource to send events to the client
+    wl_resource *callback = connection->createResource(&wl_callback_interface, 1, 2);
+    QVERIFY(callback);
+    // counts the writes which arrived on the socket of the client so far
+    int writes = 0;
+    auto readWrites = [&sv, &writes] {
+        char buffer[4096];
+        while (recv(sv[1], buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+            writes++;
+        }
+        return writes;
+    };
+
+    // immediate flushes, a flush without pending events does not write
+    wl_callback_send_done(callback, 0);
+    connection->flush();
+    QCOMPARE(readWrites(), 1);
+    connection->flush();
+    QCOMPARE(readWrites(), 1);
+
+    // deferred flushes happen once at the end of the dispatch cycle
+    writes = 0;
+    display.setFlushPolicy(Display::FlushPolicy::Deferred);
+    QCOMPARE(display.flushPolicy(), Display::FlushPolicy::Deferred);
+    wl_callback_send_done(callback, 0);
+    connection->flush();
+    wl_callback_send_done(callback, 0);
+    connection->flush();
+    connection->flush();
+    QCOMPARE(readWrites(), 0);
+    // both events got written in one go at the end of the dispatch cycle
+    QTRY_COMPARE(readWrites(), 1);
+    QTest::qWait(10);
+    QCOMPARE(readWrites(), 1);
+
+    // urgent flushes are not deferred and the scheduled flush has nothing left to write
+    writes = 0;
+    connection->flush();
+    wl_callback_send_done(callback, 0);
+    connection->flushUrgent();
+    QCOMPARE(readWrites(), 1);
+    QTest::qWait(10);
+    QCOMPARE(readWrites(), 1);
+
+    // events sent without a flush get written at the end of the dispatch cycle as well
+    writes = 0;
+    wl_callback_send_done(callback, 0);
+    QCOMPARE(readWrites(), 0);
+    QTRY_COMPARE(readWrites(), 1);
+
+    // switching back flushes the scheduled clients
+    writes = 0;
+    wl_callback_send_done(callback, 0);
+    connection->flush();
+    QCOMPARE(readWrites(), 0);
+    display.setFlushPolicy(Display::FlushPolicy::Immediate);
+    QCOMPARE(readWrites(), 1);
+
+    // a disconnected client does not get flushed any more
+    display.setFlushPolicy(Display::FlushPolicy::Deferred);
+    connection->flush();
+    QSignalSpy disconnectedSpy(connection, &ClientConnection::disconnected);
+    QVERIFY(disconnectedSpy.isValid());
+    connection->destroy();
+    QCOMPARE(disconnectedSpy.count(), 1);
+    QTest::qWait(10);
+    close(sv[1]);
+}
+
 void TestWaylandServerDisplay::testOutputManagement()
 {
     Display display;
@@ -106,7 +106,13 @@ bool Buffer::isReleased() const
 
 void Buffer::setReleased(bool released)
 {
+    if (d->released == released) {
+        return;
+    }
     d->released = released;
+    if (d->shm) {
+        d->shm->updateReusableBuffer(this);
+    }
 }
 
 QSize Buffer::size() const
@@ -126,7 +132,13 @@ bool Buffer::isUsed() const
 
 void Buffer::setUsed(bool used)
 {
+    if (d->used == used) {
+        return;
+    }
     d->used = used;
+    if (d->shm) {
+        d->shm->updateReusableBuffer(this);
+    }
 }
 
 Buffer::Format Buffer::format() const
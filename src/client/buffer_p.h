@@ -21,6 +21,8 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #define WAYLAND_BUFFER_P_H
 #include "buffer.h"
 #include "wayland_pointer_p.h"
+// Qt
+#include <QPointer>
 // wayland
 #include <wayland-client-protocol.h>
 
@@ -36,7 +38,7 @@ public:
     ~Private();
     void destroy();
 
-    ShmPool *shm;
+    QPointer<ShmPool> shm;
     WaylandPointer<wl_buffer, wl_buffer_destroy> nativeBuffer;
     bool released;
     QSize size;
@@ -44,6 +46,8 @@ public:
     size_t offset;
     bool used;
     Format format;
+    // orders the reusable buffers of a ShmPool by the time they became reusable
+    quint64 reusableSerial = 0;
 private:
     Buffer *q;
     static const struct wl_buffer_listener s_listener;
@@ -18,6 +18,7 @@ You should have received a copy of the GNU Lesser General Public
 License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "connection_thread.h"
+#include "event_reader_p.h"
 #include "logging.h"
 // Qt
 #include <QAbstractEventDispatcher>
@@ -31,6 +32,8 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <qpa/qplatformnativeinterface.h>
 // Wayland
 #include <wayland-client-protocol.h>
+// system
+#include <sys/eventfd.h>
 
 namespace KWayland
 {
@@ -46,6 +49,8 @@ public:
     void doInitConnection();
     void setupSocketNotifier();
     void setupSocketFileWatcher();
+    void dispatchEvents();
+    void wakeUpDirectQueues(int readerFd);
 
     wl_display *display = nullptr;
     int fd = -1;
@@ -57,6 +62,11 @@ public:
     bool foreign = false;
     QMetaObject::Connection eventDispatcherConnection;
     int error = 0;
+    // whether a wakeUpQueues is pending on the thread of the ConnectionThread
+    QAtomicInt wakeUpPending;
+    // the eventfds of the EventQueues with EventQueue::DispatchMode::Direct
+    QVector<int> directQueueFds;
+    QMutex directQueueMutex;
     static QVector<ConnectionThread*> connections;
     static QMutex mutex;
 private:
@@ -123,25 +133,36 @@ void ConnectionThread::Private::setupSocketNotifier()
     socketNotifier.reset(new QSocketNotifier(fd, QSocketNotifier::Read));
     QObject::connect(socketNotifier.data(), &QSocketNotifier::activated, q,
         [this]() {
-            if (!display) {
-                return;
-            }
-            if (wl_display_dispatch(display) == -1) {
-                error = wl_display_get_error(display);
-                if (error != 0) {
-                    if (display) {
-                        free(display);
-                        display = nullptr;
-                    }
-                    emit q->errorOccurred();
-                    return;
-                }
-            }
-            emit q->eventsRead();
+            dispatchEvents();
         }
     );
 }
 
+void ConnectionThread::Private::dispatchEvents()
+{
+    if (!display) {
+        return;
+    }
+    // other threads might read from the display as well, e.g. in wl_display_roundtrip
+    // or an EventQueue dispatching on its own thread, so never block on the socket
+    const int result = readEvents(display, nullptr);
+    if (result == 1) {
+        wakeUpDirectQueues(-1);
+    }
+    if (result == -1 || wl_display_dispatch_pending(display) == -1) {
+        error = wl_display_get_error(display);
+        if (error != 0) {
+            if (display) {
+                free(display);
+                display = nullptr;
+            }
+            emit q->errorOccurred();
+            return;
+        }
+    }
+    emit q->eventsRead();
+}
+
 void ConnectionThread::Private::setupSocketFileWatcher()
 {
     if (!runtimeDir.exists() || fd != -1) {
@@ -271,6 +292,44 @@ void ConnectionThread::flush()
     wl_display_flush(d->display);
 }
 
+void ConnectionThread::Private::wakeUpDirectQueues(int readerFd)
+{
+    QMutexLocker lock(&directQueueMutex);
+    for (int fd : qAsConst(directQueueFds)) {
+        if (fd != readerFd) {
+            eventfd_write(fd, 1);
+        }
+    }
+}
+
+void ConnectionThread::addDirectQueue(int fd)
+{
+    QMutexLocker lock(&d->directQueueMutex);
+    d->directQueueFds << fd;
+}
+
+void ConnectionThread::removeDirectQueue(int fd)
+{
+    QMutexLocker lock(&d->directQueueMutex);
+    d->directQueueFds.removeOne(fd);
+}
+
+void ConnectionThread::wakeUpQueues(int readerFd)
+{
+    // the direct queues get woken up right away from the reading thread
+    d->wakeUpDirectQueues(readerFd);
+    // several EventQueues might read at the same time, one wake up covers all of them
+    if (!d->wakeUpPending.testAndSetOrdered(0, 1)) {
+        return;
+    }
+    QMetaObject::invokeMethod(this,
+        [this] {
+            d->wakeUpPending.storeRelease(0);
+            d->dispatchEvents();
+        },
+        Qt::QueuedConnection);
+}
+
 void ConnectionThread::roundtrip()
 {
     if (!d->display) {
@@ -235,6 +235,9 @@ Q_SIGNALS:
     void failed();
     /**
      * Emitted whenever new events are ready to be read.
+     *
+     * Since 5.58 this is also emitted after an EventQueue read the events on its own thread,
+     * so that the events it read for the other EventQueues get dispatched.
      **/
     void eventsRead();
     /**
@@ -266,6 +269,20 @@ private Q_SLOTS:
     void doInitConnection();
 
 private:
+    friend class EventQueue;
+    /**
+     * Signals the eventfds of the direct EventQueues except @p readerFd, dispatches the
+     * default queue and emits eventsRead on the thread of the ConnectionThread after
+     * events got read on another thread.
+     * Can be called from any thread.
+     **/
+    void wakeUpQueues(int readerFd = -1);
+    /**
+     * The eventfd @p fd gets signalled whenever events got read from the display.
+     * Can be called from any thread.
+     **/
+    void addDirectQueue(int fd);
+    void removeDirectQueue(int fd);
     class Private;
     QScopedPointer<Private> d;
 };
@@ -19,10 +19,18 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "event_queue.h"
 #include "connection_thread.h"
+#include "event_reader_p.h"
 #include "wayland_pointer_p.h"
 
+#include <QAbstractEventDispatcher>
+#include <QPointer>
+#include <QSocketNotifier>
+
 #include <wayland-client.h>
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 namespace KWayland
 {
 namespace Client
@@ -32,9 +40,25 @@ class Q_DECL_HIDDEN EventQueue::Private
 {
 public:
     Private(EventQueue *q);
+    /**
+     * Reads the available events and wakes up the other queues if any got read.
+     * @returns @c -1 on error, otherwise @c 0
+     **/
+    int read();
+    void dispatchDirect();
+    void stopDirectDispatch();
 
     wl_display *display = nullptr;
     WaylandPointer<wl_event_queue, wl_event_queue_destroy> queue;
+    QPointer<ConnectionThread> connection;
+    DispatchMode dispatchMode = DispatchMode::Queued;
+    // direct dispatch related members
+    QSocketNotifier *notifier = nullptr;
+    // signalled by whoever reads events from the display
+    int wakeUpFd = -1;
+    QSocketNotifier *wakeUpNotifier = nullptr;
+    QMetaObject::Connection aboutToBlockConnection;
+    QMetaObject::Connection eventsReadConnection;
 
 private:
     EventQueue *q;
@@ -45,6 +69,51 @@ EventQueue::Private::Private(EventQueue *q)
 {
 }
 
+int EventQueue::Private::read()
+{
+    const int result = readEvents(display, queue);
+    if (result == -1) {
+        return -1;
+    }
+    if (result == 1 && connection) {
+        // the socket is drained, so the other queues don't get notified about the events read for them
+        connection->wakeUpQueues(wakeUpFd);
+    }
+    return 0;
+}
+
+void EventQueue::Private::dispatchDirect()
+{
+    if (!display || !queue) {
+        return;
+    }
+    if (read() == -1 || wl_display_dispatch_queue_pending(display, queue) == -1) {
+        stopDirectDispatch();
+    }
+}
+
+void EventQueue::Private::stopDirectDispatch()
+{
+    QObject::disconnect(aboutToBlockConnection);
+    QObject::disconnect(eventsReadConnection);
+    // might be called from the activated signal of a notifier
+    if (notifier) {
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+        notifier = nullptr;
+    }
+    if (wakeUpFd != -1) {
+        if (connection) {
+            connection->removeDirectQueue(wakeUpFd);
+        }
+        wakeUpNotifier->setEnabled(false);
+        wakeUpNotifier->deleteLater();
+        wakeUpNotifier = nullptr;
+        close(wakeUpFd);
+        wakeUpFd = -1;
+    }
+}
+
 EventQueue::EventQueue(QObject *parent)
     : QObject(parent)
     , d(new Private(this))
@@ -58,14 +127,20 @@ EventQueue::~EventQueue()
 
 void EventQueue::release()
 {
+    d->stopDirectDispatch();
+    d->dispatchMode = DispatchMode::Queued;
     d->queue.release();
     d->display = nullptr;
+    d->connection.clear();
 }
 
 void EventQueue::destroy()
 {
+    d->stopDirectDispatch();
+    d->dispatchMode = DispatchMode::Queued;
     d->queue.destroy();
     d->display = nullptr;
+    d->connection.clear();
 }
 
 bool EventQueue::isValid()
@@ -85,14 +160,68 @@ void EventQueue::setup(wl_display *display)
 void EventQueue::setup(ConnectionThread *connection)
 {
     setup(connection->display());
+    d->connection = connection;
     connect(connection, &ConnectionThread::eventsRead, this, &EventQueue::dispatch, Qt::QueuedConnection);
 }
 
+void EventQueue::setup(ConnectionThread *connection, DispatchMode mode)
+{
+    if (mode == DispatchMode::Queued) {
+        setup(connection);
+        return;
+    }
+    setup(connection->display());
+    d->connection = connection;
+    d->dispatchMode = mode;
+    d->notifier = new QSocketNotifier(wl_display_get_fd(d->display), QSocketNotifier::Read, this);
+    connect(d->notifier, &QSocketNotifier::activated, this, [this] { d->dispatchDirect(); });
+    // the events read by another thread don't activate the notifier, the reading thread
+    // signals the eventfd instead of going through the event loop of the ConnectionThread
+    d->wakeUpFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (d->wakeUpFd != -1) {
+        d->wakeUpNotifier = new QSocketNotifier(d->wakeUpFd, QSocketNotifier::Read, this);
+        connect(d->wakeUpNotifier, &QSocketNotifier::activated, this,
+            [this] {
+                eventfd_t count;
+                eventfd_read(d->wakeUpFd, &count);
+                d->dispatchDirect();
+            });
+        connection->addDirectQueue(d->wakeUpFd);
+    } else {
+        d->eventsReadConnection = connect(connection, &ConnectionThread::eventsRead, this,
+            [this] {
+                d->dispatchDirect();
+            },
+            Qt::QueuedConnection);
+    }
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    Q_ASSERT(dispatcher);
+    // a single flush for all requests of this event loop iteration
+    d->aboutToBlockConnection = connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this,
+        [this] {
+            if (d->display) {
+                wl_display_flush(d->display);
+            }
+        },
+        Qt::DirectConnection);
+}
+
+EventQueue::DispatchMode EventQueue::dispatchMode() const
+{
+    return d->dispatchMode;
+}
+
 void EventQueue::dispatch()
 {
     if (!d->display || !d->queue) {
         return;
     }
+    // read what is available on the socket ourselves instead of relying on the thread of the
+    // ConnectionThread having read the events for this queue, only a queue set up for a
+    // ConnectionThread can wake up the other queues afterwards
+    if (d->connection && d->read() == -1) {
+        return;
+    }
     wl_display_dispatch_queue_pending(d->display, d->queue);
     wl_display_flush(d->display);
 }
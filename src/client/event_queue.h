@@ -70,6 +70,23 @@ class KWAYLANDCLIENT_EXPORT EventQueue : public QObject
 {
     Q_OBJECT
 public:
+    /**
+     * How the events get dispatched for an EventQueue set up for a ConnectionThread.
+     * @see setup(ConnectionThread *, DispatchMode)
+     * @since 5.58
+     **/
+    enum class DispatchMode {
+        /**
+         * dispatch gets invoked through a queued connection to the eventsRead
+         * signal of the ConnectionThread.
+         **/
+        Queued,
+        /**
+         * The EventQueue watches the Wayland socket itself and dispatches its
+         * events directly on its thread as soon as they arrive.
+         **/
+        Direct
+    };
     explicit EventQueue(QObject *parent = nullptr);
     virtual ~EventQueue();
 
@@ -91,6 +108,35 @@ public:
      * @see dispatch
      **/
     void setup(ConnectionThread *connection);
+    /**
+     * Creates the event queue for the @p connection using the dispatch @p mode.
+     *
+     * With DispatchMode::Queued this is the same as setup(ConnectionThread*).
+     *
+     * With DispatchMode::Direct the events are dispatched without waiting for the
+     * ConnectionThread to read them and without an event loop iteration in between.
+     * The EventQueue watches the Wayland socket and reads and dispatches the events
+     * as soon as it becomes readable. No read is held prepared across the event loop,
+     * so other code on the same thread can still read, e.g. in a roundtrip. If the
+     * ConnectionThread or another EventQueue reads the events first, it wakes up the
+     * EventQueue through an eventfd right away, without waiting for the eventsRead
+     * signal. Events read by calling libwayland directly, e.g. wl_display_roundtrip
+     * on another thread, are only dispatched with the next events arriving on the
+     * socket. All requests sent during one event loop iteration are flushed
+     * once when the event loop is about to block instead of after each dispatch.
+     *
+     * The direct mode is bound to the event loop of the thread calling setup. The
+     * EventQueue must not be moved to another thread afterwards.
+     *
+     * @see dispatchMode
+     * @since 5.58
+     **/
+    void setup(ConnectionThread *connection, DispatchMode mode);
+    /**
+     * @returns The DispatchMode the EventQueue got set up with.
+     * @since 5.58
+     **/
+    DispatchMode dispatchMode() const;
 
     /**
      * @returns @c true if EventQueue is setup.
@@ -136,6 +182,13 @@ public:
 public Q_SLOTS:
     /**
      * Dispatches all pending events on the EventQueue.
+     *
+     * Since 5.58 the events available on the Wayland socket are read first, without
+     * blocking, if the EventQueue got set up for a ConnectionThread. Thus dispatch can be
+     * invoked from the thread of the EventQueue, e.g. from a socket notifier, without the
+     * ConnectionThread reading the events for it. Several EventQueues on different threads
+     * can read and dispatch concurrently. If events got read, the ConnectionThread
+     * dispatches the default queue and emits eventsRead for the other EventQueues.
      **/
     void dispatch();
 
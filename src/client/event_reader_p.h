@@ -0,0 +1,67 @@
+/********************************************************************
+Copyright 2019  Martin Gräßlin <mgraesslin@kde.org>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) version 3, or any
+later version accepted by the membership of KDE e.V. (or its
+successor approved by the membership of KDE e.V.), which shall
+act as a proxy defined in Section 6 of version 3 of the license.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef WAYLAND_EVENT_READER_P_H
+#define WAYLAND_EVENT_READER_P_H
+
+#include <wayland-client.h>
+
+#include <poll.h>
+
+namespace KWayland
+{
+namespace Client
+{
+
+/**
+ * Reads the events available on the socket of @p display into their event queues without blocking.
+ *
+ * The events are read following the wl_display_prepare_read protocol, so any number of threads
+ * can read from the same @p display, including threads blocking in wl_display_roundtrip. The
+ * events already pending on @p queue, the default queue if @c nullptr, are dispatched first as
+ * preparing the read fails as long as there are any.
+ *
+ * The caller needs to dispatch the pending events of its queue afterwards. If events got read,
+ * the events of all other queues got read as well, so the threads dispatching them need to be
+ * woken up: the socket does not become readable again for those events.
+ *
+ * @returns @c -1 on error, @c 1 if events got read, otherwise @c 0
+ **/
+inline int readEvents(wl_display *display, wl_event_queue *queue)
+{
+    while ((queue ? wl_display_prepare_read_queue(display, queue) : wl_display_prepare_read(display)) != 0) {
+        if ((queue ? wl_display_dispatch_queue_pending(display, queue) : wl_display_dispatch_pending(display)) == -1) {
+            return -1;
+        }
+    }
+    // the events to read might be the replies to not yet sent requests
+    wl_display_flush(display);
+    pollfd fd = { wl_display_get_fd(display), POLLIN, 0 };
+    if (poll(&fd, 1, 0) <= 0) {
+        // another thread read the events in the meantime, wl_display_read_events would block
+        wl_display_cancel_read(display);
+        return 0;
+    }
+    return wl_display_read_events(display) == -1 ? -1 : 1;
+}
+
+}
+}
+
+#endif
@@ -23,11 +23,18 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "buffer_p.h"
 #include "logging.h"
 #include "wayland_pointer_p.h"
+#include <config-kwayland.h>
 // Qt
 #include <QDebug>
+#include <QHash>
 #include <QImage>
+#include <QMap>
 #include <QTemporaryFile>
+#include <QVector>
+// STL
+#include <limits>
 // system
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
 // wayland
@@ -38,29 +45,85 @@ namespace KWayland
 namespace Client
 {
 
+namespace {
+struct BufferKey
+{
+    QSize size;
+    int32_t stride;
+    Buffer::Format format;
+};
+
+inline bool operator==(const BufferKey &a, const BufferKey &b)
+{
+    return a.size == b.size && a.stride == b.stride && a.format == b.format;
+}
+
+inline uint qHash(const BufferKey &key, uint seed = 0)
+{
+    return ::qHash((quint64(key.size.width()) << 32) | quint32(key.size.height()), seed)
+        ^ ::qHash(key.stride, seed) ^ uint(key.format);
+}
+
+inline BufferKey bufferKey(Buffer *buffer)
+{
+    return BufferKey{buffer->size(), buffer->stride(), buffer->format()};
+}
+}
+
 class Q_DECL_HIDDEN ShmPool::Private
 {
 public:
     Private(ShmPool *q);
     bool createPool();
+    bool openPoolFile();
+    void closePoolFile();
+    void unmapPool();
     bool resizePool(int32_t newSize);
-    QList<QSharedPointer<Buffer>>::iterator getBuffer(const QSize &size, int32_t stride, Buffer::Format format);
+    QSharedPointer<Buffer> getBuffer(const QSize &size, int32_t stride, Buffer::Format format);
+    /**
+     * Reserves @p byteCount bytes in the pool, preferring the first free range which is large
+     * enough over the unused end of the pool.
+     * @returns the offset of the reserved range or @c -1 if the pool is too small
+     **/
+    int32_t allocateRange(int32_t byteCount);
+    /**
+     * Gives the range at @p rangeOffset with @p byteCount bytes back to the pool.
+     * Adjacent free ranges get merged.
+     **/
+    void freeRange(int32_t rangeOffset, int32_t byteCount);
+    /**
+     * Destroys the Buffer which is released by the server and not used for the longest time
+     * and gives its memory back to the pool.
+     * @returns whether a Buffer got destroyed
+     **/
+    bool reclaimBuffer();
+    /**
+     * Reclaims Buffers, oldest first, till a range of @p byteCount bytes can be allocated.
+     * @returns the offset of the allocated range or @c -1 if reclaiming all Buffers did not suffice
+     **/
+    int32_t allocateRangeReclaiming(int32_t byteCount);
     WaylandPointer<wl_shm, wl_shm_destroy> shm;
     WaylandPointer<wl_shm_pool, wl_shm_pool_destroy> pool;
     void *poolData = nullptr;
     int32_t size = 1024;
+    int fd = -1;
     QScopedPointer<QTemporaryFile> tmpFile;
     bool valid = false;
-    int offset = 0;
-    QList<QSharedPointer<Buffer>> buffers;
+    // everything starting at offset is unused
+    int32_t offset = 0;
+    // free ranges before offset, maps the offset of the range to its size
+    QMap<int32_t, int32_t> freeRanges;
+    QHash<Buffer*, QSharedPointer<Buffer>> buffers;
+    // the released and not used buffers by size, stride and format, each ordered by reusableSerial
+    QHash<BufferKey, QVector<Buffer*>> reusableBuffers;
+    quint64 reusableSerial = 0;
     EventQueue *queue = nullptr;
 private:
     ShmPool *q;
 };
 
 ShmPool::Private::Private(ShmPool *q)
-    : tmpFile(new QTemporaryFile())
-    , q(q)
+    : q(q)
 {
 }
 
@@ -78,16 +141,15 @@ ShmPool::~ShmPool()
 
 void ShmPool::release()
 {
+    d->reusableBuffers.clear();
     d->buffers.clear();
-    if (d->poolData) {
-        munmap(d->poolData, d->size);
-        d->poolData = nullptr;
-    }
+    d->unmapPool();
     d->pool.release();
     d->shm.release();
-    d->tmpFile->close();
+    d->closePoolFile();
     d->valid = false;
     d->offset = 0;
+    d->freeRanges.clear();
 }
 
 void ShmPool::destroy()
@@ -95,16 +157,15 @@ void ShmPool::destroy()
     for (auto b : d->buffers) {
         b->d->destroy();
     }
+    d->reusableBuffers.clear();
     d->buffers.clear();
-    if (d->poolData) {
-        munmap(d->poolData, d->size);
-        d->poolData = nullptr;
-    }
+    d->unmapPool();
     d->pool.destroy();
     d->shm.destroy();
-    d->tmpFile->close();
+    d->closePoolFile();
     d->valid = false;
     d->offset = 0;
+    d->freeRanges.clear();
 }
 
 void ShmPool::setup(wl_shm *shm)
@@ -125,8 +186,18 @@ EventQueue *ShmPool::eventQueue()
     return d->queue;
 }
 
-bool ShmPool::Private::createPool()
+bool ShmPool::Private::openPoolFile()
 {
+#if HAVE_MEMFD
+    fd = memfd_create("kwayland-shared", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        // the pool only grows, this protects the server from a shrinking file
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+        return true;
+    }
+    qCDebug(KWAYLAND_CLIENT) << "Could not create memfd for Shm pool, falling back to temporary file";
+#endif
+    tmpFile.reset(new QTemporaryFile());
     if (!tmpFile->open()) {
         qCDebug(KWAYLAND_CLIENT) << "Could not open temporary file for Shm pool";
         return false;
@@ -134,12 +205,42 @@ bool ShmPool::Private::createPool()
     if (unlink(tmpFile->fileName().toUtf8().constData()) != 0) {
         qCDebug(KWAYLAND_CLIENT) << "Unlinking temporary file for Shm pool from file system failed";
     }
-    if (ftruncate(tmpFile->handle(), size) < 0) {
+    fd = tmpFile->handle();
+    return true;
+}
+
+void ShmPool::Private::closePoolFile()
+{
+    if (tmpFile) {
+        tmpFile.reset();
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    fd = -1;
+}
+
+void ShmPool::Private::unmapPool()
+{
+    if (poolData) {
+        munmap(poolData, size);
+        poolData = nullptr;
+    }
+}
+
+bool ShmPool::Private::createPool()
+{
+    if (!openPoolFile()) {
+        return false;
+    }
+    if (ftruncate(fd, size) < 0) {
         qCDebug(KWAYLAND_CLIENT) << "Could not set size for Shm pool file";
         return false;
     }
-    poolData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, tmpFile->handle(), 0);
-    pool.setup(wl_shm_create_pool(shm, tmpFile->handle(), size));
+    poolData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (poolData == MAP_FAILED) {
+        poolData = nullptr;
+    }
+    pool.setup(wl_shm_create_pool(shm, fd, size));
 
     if (!poolData || !pool) {
         qCDebug(KWAYLAND_CLIENT) << "Creating Shm pool failed";
@@ -150,15 +251,16 @@ bool ShmPool::Private::createPool()
 
 bool ShmPool::Private::resizePool(int32_t newSize)
 {
-    if (ftruncate(tmpFile->handle(), newSize) < 0) {
+    if (ftruncate(fd, newSize) < 0) {
         qCDebug(KWAYLAND_CLIENT) << "Could not set new size for Shm pool file";
         return false;
     }
     wl_shm_pool_resize(pool, newSize);
-    munmap(poolData, size);
-    poolData = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, tmpFile->handle(), 0);
+    unmapPool();
+    poolData = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     size = newSize;
-    if (!poolData) {
+    if (poolData == MAP_FAILED) {
+        poolData = nullptr;
         qCDebug(KWAYLAND_CLIENT) << "Resizing Shm pool failed";
         return false;
     }
@@ -166,6 +268,87 @@ bool ShmPool::Private::resizePool(int32_t newSize)
     return true;
 }
 
+int32_t ShmPool::Private::allocateRange(int32_t byteCount)
+{
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it.value() < byteCount) {
+            continue;
+        }
+        const int32_t rangeOffset = it.key();
+        const int32_t remaining = it.value() - byteCount;
+        freeRanges.erase(it);
+        if (remaining > 0) {
+            freeRanges.insert(rangeOffset + byteCount, remaining);
+        }
+        return rangeOffset;
+    }
+    if (offset + byteCount <= size) {
+        const int32_t rangeOffset = offset;
+        offset += byteCount;
+        return rangeOffset;
+    }
+    return -1;
+}
+
+void ShmPool::Private::freeRange(int32_t rangeOffset, int32_t byteCount)
+{
+    // merge with the preceding range
+    auto it = freeRanges.lowerBound(rangeOffset);
+    if (it != freeRanges.begin()) {
+        auto previous = it - 1;
+        if (previous.key() + previous.value() == rangeOffset) {
+            rangeOffset = previous.key();
+            byteCount += previous.value();
+            freeRanges.erase(previous);
+        }
+    }
+    // merge with the following range
+    it = freeRanges.find(rangeOffset + byteCount);
+    if (it != freeRanges.end()) {
+        byteCount += it.value();
+        freeRanges.erase(it);
+    }
+    if (rangeOffset + byteCount == offset) {
+        // the range ends at the unused end of the pool
+        offset = rangeOffset;
+        return;
+    }
+    freeRanges.insert(rangeOffset, byteCount);
+}
+
+bool ShmPool::Private::reclaimBuffer()
+{
+    // the first buffer of each bucket is the oldest one of the bucket
+    auto oldest = reusableBuffers.end();
+    for (auto it = reusableBuffers.begin(); it != reusableBuffers.end(); ++it) {
+        if (oldest == reusableBuffers.end() || it->first()->d->reusableSerial < oldest->first()->d->reusableSerial) {
+            oldest = it;
+        }
+    }
+    if (oldest == reusableBuffers.end()) {
+        return false;
+    }
+    Buffer *buffer = oldest->takeFirst();
+    if (oldest->isEmpty()) {
+        reusableBuffers.erase(oldest);
+    }
+    freeRange(buffer->d->offset, buffer->size().height() * buffer->stride());
+    // take the buffer out of the hash before it gets destroyed
+    QSharedPointer<Buffer> reclaimed = buffers.take(buffer);
+    return true;
+}
+
+int32_t ShmPool::Private::allocateRangeReclaiming(int32_t byteCount)
+{
+    while (reclaimBuffer()) {
+        const int32_t rangeOffset = allocateRange(byteCount);
+        if (rangeOffset != -1) {
+            return rangeOffset;
+        }
+    }
+    return -1;
+}
+
 namespace {
 static Buffer::Format toBufferFormat(const QImage &image)
 {
@@ -190,17 +373,17 @@ Buffer::Ptr ShmPool::createBuffer(const QImage& image)
         return QWeakPointer<Buffer>();
     }
     auto format = toBufferFormat(image);
-    auto it = d->getBuffer(image.size(), image.bytesPerLine(), format);
-    if (it == d->buffers.end()) {
+    auto buffer = d->getBuffer(image.size(), image.bytesPerLine(), format);
+    if (!buffer) {
         return QWeakPointer<Buffer>();
     }
     if (format == Buffer::Format::ARGB32 && image.format() != QImage::Format_ARGB32_Premultiplied) {
         auto imageCopy = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-        (*it)->copy(imageCopy.bits());
+        buffer->copy(imageCopy.bits());
     } else {
-        (*it)->copy(image.bits());
+        buffer->copy(image.bits());
     }
-    return QWeakPointer<Buffer>(*it);
+    return QWeakPointer<Buffer>(buffer);
 }
 
 Buffer::Ptr ShmPool::createBuffer(const QSize &size, int32_t stride, const void *src, Buffer::Format format)
@@ -208,12 +391,12 @@ Buffer::Ptr ShmPool::createBuffer(const QSize &size, int32_t stride, const void
     if (size.isEmpty() || !d->valid) {
         return QWeakPointer<Buffer>();
     }
-    auto it = d->getBuffer(size, stride, format);
-    if (it == d->buffers.end()) {
+    auto buffer = d->getBuffer(size, stride, format);
+    if (!buffer) {
         return QWeakPointer<Buffer>();
     }
-    (*it)->copy(src);
-    return QWeakPointer<Buffer>(*it);
+    buffer->copy(src);
+    return QWeakPointer<Buffer>(buffer);
 }
 
 namespace {
@@ -231,45 +414,52 @@ static wl_shm_format toWaylandFormat(Buffer::Format format)
 
 Buffer::Ptr ShmPool::getBuffer(const QSize &size, int32_t stride, Buffer::Format format)
 {
-    auto it = d->getBuffer(size, stride, format);
-    if (it == d->buffers.end()) {
-        return QWeakPointer<Buffer>();
-    }
-    return QWeakPointer<Buffer>(*it);
+    return QWeakPointer<Buffer>(d->getBuffer(size, stride, format));
 }
 
-QList<QSharedPointer<Buffer>>::iterator ShmPool::Private::getBuffer(const QSize &s, int32_t stride, Buffer::Format format)
+QSharedPointer<Buffer> ShmPool::Private::getBuffer(const QSize &s, int32_t stride, Buffer::Format format)
 {
-    for (auto it = buffers.begin(); it != buffers.end(); ++it) {
-        auto buffer = *it;
-        if (!buffer->isReleased() || buffer->isUsed()) {
-            continue;
-        }
-        if (buffer->size() != s || buffer->stride() != stride || buffer->format() != format) {
-            continue;
-        }
+    auto bucket = reusableBuffers.find(BufferKey{s, stride, format});
+    if (bucket != reusableBuffers.end()) {
+        Buffer *buffer = bucket->last();
+        // removes the buffer from the bucket
         buffer->setReleased(false);
-        return it;
+        return buffers.value(buffer);
+    }
+    const qint64 requiredBytes = qint64(s.height()) * stride;
+    if (requiredBytes <= 0 || requiredBytes > std::numeric_limits<int32_t>::max()) {
+        return QSharedPointer<Buffer>();
+    }
+    const int32_t byteCount = requiredBytes;
+    int32_t bufferOffset = allocateRange(byteCount);
+    if (bufferOffset == -1) {
+        // only reclaim as many unused buffers as needed, the others might still get reused
+        bufferOffset = allocateRangeReclaiming(byteCount);
     }
-    const int32_t byteCount = s.height() * stride;
-    if (offset + byteCount > size) {
-        if (!resizePool(size + byteCount)) {
-            return buffers.end();
+    if (bufferOffset == -1) {
+        // grow geometrically to not resize on each new buffer
+        const qint64 newSize = qMin(qMax(qint64(size) * 2, qint64(offset) + byteCount),
+                                    qint64(std::numeric_limits<int32_t>::max()));
+        if (newSize < qint64(offset) + byteCount || !resizePool(newSize)) {
+            return QSharedPointer<Buffer>();
         }
+        bufferOffset = allocateRange(byteCount);
+        Q_ASSERT(bufferOffset != -1);
     }
     // we don't have a buffer which we could reuse - need to create a new one
-    wl_buffer *native = wl_shm_pool_create_buffer(pool, offset, s.width(), s.height(),
+    wl_buffer *native = wl_shm_pool_create_buffer(pool, bufferOffset, s.width(), s.height(),
                                                   stride, toWaylandFormat(format));
     if (!native) {
-        return buffers.end();
+        freeRange(bufferOffset, byteCount);
+        return QSharedPointer<Buffer>();
     }
     if (queue) {
         queue->addProxy(native);
     }
-    Buffer *buffer = new Buffer(q, native, s, stride, offset, format);
-    offset += byteCount;
-    auto it = buffers.insert(buffers.end(), QSharedPointer<Buffer>(buffer));
-    return it;
+    Buffer *buffer = new Buffer(q, native, s, stride, bufferOffset, format);
+    QSharedPointer<Buffer> ptr(buffer);
+    buffers.insert(buffer, ptr);
+    return ptr;
 }
 
 bool ShmPool::isValid() const
@@ -282,6 +472,82 @@ void* ShmPool::poolAddress() const
     return d->poolData;
 }
 
+int32_t ShmPool::poolSize() const
+{
+    return d->size;
+}
+
+int ShmPool::bufferCount() const
+{
+    return d->buffers.count();
+}
+
+int ShmPool::releasedBufferCount() const
+{
+    int count = 0;
+    for (const auto &bucket : d->reusableBuffers) {
+        count += bucket.count();
+    }
+    return count;
+}
+
+int32_t ShmPool::wastedBytes() const
+{
+    int32_t usedBytes = 0;
+    for (auto it = d->buffers.constBegin(); it != d->buffers.constEnd(); ++it) {
+        Buffer *buffer = it.key();
+        if (buffer->isReleased() && !buffer->isUsed()) {
+            continue;
+        }
+        usedBytes += buffer->size().height() * buffer->stride();
+    }
+    return d->size - usedBytes;
+}
+
+void ShmPool::updateReusableBuffer(Buffer *buffer)
+{
+    if (!d->buffers.contains(buffer)) {
+        return;
+    }
+    const BufferKey key = bufferKey(buffer);
+    auto bucket = d->reusableBuffers.find(key);
+    if (buffer->isReleased() && !buffer->isUsed()) {
+        if (bucket == d->reusableBuffers.end()) {
+            buffer->d->reusableSerial = ++d->reusableSerial;
+            d->reusableBuffers.insert(key, QVector<Buffer*>{buffer});
+        } else if (!bucket->contains(buffer)) {
+            buffer->d->reusableSerial = ++d->reusableSerial;
+            bucket->append(buffer);
+        }
+        return;
+    }
+    if (bucket == d->reusableBuffers.end()) {
+        return;
+    }
+    bucket->removeOne(buffer);
+    if (bucket->isEmpty()) {
+        d->reusableBuffers.erase(bucket);
+    }
+}
+
+void ShmPool::trim()
+{
+    if (!d->valid) {
+        return;
+    }
+    while (d->reclaimBuffer()) {
+    }
+#ifdef FALLOC_FL_PUNCH_HOLE
+    // give the memory of the free ranges back to the system, the pool itself cannot shrink
+    for (auto it = d->freeRanges.constBegin(); it != d->freeRanges.constEnd(); ++it) {
+        fallocate(d->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, it.key(), it.value());
+    }
+    if (d->offset < d->size) {
+        fallocate(d->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, d->offset, d->size - d->offset);
+    }
+#endif
+}
+
 wl_shm *ShmPool::shm()
 {
     return d->shm;
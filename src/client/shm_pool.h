@@ -65,6 +65,9 @@ class EventQueue;
  * @li the stride matches
  * @li the format matches
  *
+ * The released Buffers are indexed by size, stride and format, thus finding a Buffer
+ * to reuse does not depend on the number of Buffers held by the ShmPool.
+ *
  * The ownership of a Buffer stays with ShmPool. The ShmPool might destroy the
  * Buffer at any given time. Because of that ShmPool only provides QWeakPointer
  * for Buffers. Users should always check whether the pointer is still valid and
@@ -125,6 +128,11 @@ class EventQueue;
  * all existing Buffers are unmapped and any shared objects must be recreated. The ShmPool emits
  * the signal poolResized() after the pool got resized.
  *
+ * Before resizing, the ShmPool destroys all Buffers which are released and not used and reuses
+ * their memory for new Buffers. The pool grows at least by a factor of two, so that a client
+ * changing its size frequently does not remap the pool for each new Buffer. Memory of destroyed
+ * Buffers can be given back to the system with trim().
+ *
  * @see Buffer
  **/
 class KWAYLANDCLIENT_EXPORT ShmPool : public QObject
@@ -211,6 +219,43 @@ public:
      **/
     Buffer::Ptr createBuffer(const QSize &size, int32_t stride, const void *src, Buffer::Format format = Buffer::Format::ARGB32);
     void *poolAddress() const;
+    /**
+     * @returns The size of the shared memory pool in bytes.
+     * @see poolResized
+     * @since 5.58
+     **/
+    int32_t poolSize() const;
+    /**
+     * Destroys all Buffers which are released and not used and gives the memory
+     * not used by any Buffer back to the system.
+     *
+     * The size of the pool does not change, as a shared memory pool cannot shrink.
+     * A client should call this method when it does not expect to need new Buffers
+     * soon, e.g. after it got hidden.
+     * @since 5.58
+     **/
+    void trim();
+    /**
+     * @returns The number of Buffers held by this ShmPool, including the released ones.
+     * @see releasedBufferCount
+     * @since 5.58
+     **/
+    int bufferCount() const;
+    /**
+     * @returns The number of Buffers which are released by the server and not used,
+     * and thus can be reused for a new Buffer with the same size, stride and format.
+     * @see bufferCount
+     * @since 5.58
+     **/
+    int releasedBufferCount() const;
+    /**
+     * @returns The number of bytes in the shared memory pool which are not backing
+     * a Buffer in use, that is memory which is free, fragmented or held by released Buffers.
+     * @see poolSize
+     * @see trim
+     * @since 5.58
+     **/
+    int32_t wastedBytes() const;
     /**
      * Provides a Buffer with @p size, @p stride and @p format.
      *
@@ -244,6 +289,8 @@ Q_SIGNALS:
     void removed();
 
 private:
+    friend class Buffer;
+    void updateReusableBuffer(Buffer *buffer);
     class Private;
     QScopedPointer<Private> d;
 };
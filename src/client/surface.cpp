@@ -47,6 +47,7 @@ public:
     QSize size;
     bool foreign = false;
     qint32 scale = 1;
+    Output::Transform transform = Output::Transform::Normal;
     QVector<Output *> outputs;
 
     void setup(wl_surface *s);
@@ -239,6 +240,33 @@ void Surface::damage(const QRect &rect)
     wl_surface_damage(d->surface, rect.x(), rect.y(), rect.width(), rect.height());
 }
 
+void Surface::damageBuffer(const QRegion &region)
+{
+    for (const QRect &r : region.rects()) {
+        damageBuffer(r);
+    }
+}
+
+void Surface::damageBuffer(const QRect &rect)
+{
+    Q_ASSERT(isValid());
+    if (wl_surface_get_version(d->surface) < WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION) {
+        if (d->transform != Output::Transform::Normal) {
+            // the buffer size needed to invert the transform is not known, the compositor clips the damage
+            damage(QRect(0, 0, INT32_MAX, INT32_MAX));
+            return;
+        }
+        // round outwards to cover all damaged pixels
+        const int left = rect.x() / d->scale;
+        const int top = rect.y() / d->scale;
+        const int right = (rect.x() + rect.width() + d->scale - 1) / d->scale;
+        const int bottom = (rect.y() + rect.height() + d->scale - 1) / d->scale;
+        damage(QRect(left, top, right - left, bottom - top));
+        return;
+    }
+    wl_surface_damage_buffer(d->surface, rect.x(), rect.y(), rect.width(), rect.height());
+}
+
 void Surface::attachBuffer(wl_buffer *buffer, const QPoint &offset)
 {
     Q_ASSERT(isValid());
@@ -339,6 +367,38 @@ void Surface::setScale(qint32 scale)
     wl_surface_set_buffer_scale(d->surface, scale);
 }
 
+void Surface::setBufferTransform(Output::Transform transform)
+{
+    d->transform = transform;
+    auto toWayland = [transform] {
+        switch (transform) {
+        case Output::Transform::Rotated90:
+            return WL_OUTPUT_TRANSFORM_90;
+        case Output::Transform::Rotated180:
+            return WL_OUTPUT_TRANSFORM_180;
+        case Output::Transform::Rotated270:
+            return WL_OUTPUT_TRANSFORM_270;
+        case Output::Transform::Flipped:
+            return WL_OUTPUT_TRANSFORM_FLIPPED;
+        case Output::Transform::Flipped90:
+            return WL_OUTPUT_TRANSFORM_FLIPPED_90;
+        case Output::Transform::Flipped180:
+            return WL_OUTPUT_TRANSFORM_FLIPPED_180;
+        case Output::Transform::Flipped270:
+            return WL_OUTPUT_TRANSFORM_FLIPPED_270;
+        case Output::Transform::Normal:
+        default:
+            return WL_OUTPUT_TRANSFORM_NORMAL;
+        }
+    };
+    wl_surface_set_buffer_transform(d->surface, toWayland());
+}
+
+Output::Transform Surface::bufferTransform() const
+{
+    return d->transform;
+}
+
 QVector<Output *> Surface::outputs() const
 {
     return d->outputs;
@@ -21,6 +21,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #define WAYLAND_SURFACE_H
 
 #include "buffer.h"
+#include "output.h"
 
 #include <QObject>
 #include <QPoint>
@@ -39,7 +40,6 @@ namespace KWayland
 namespace Client
 {
 
-class Output;
 class Region;
 
 /**
@@ -155,6 +155,27 @@ public:
      * Mark @p region as damaged for the next frame.
      **/
     void damage(const QRegion &region);
+    /**
+     * Mark @p rect in buffer coordinates as damaged for the next frame.
+     *
+     * In contrast to damage the @p rect is not affected by the scale of the Surface,
+     * which allows to damage exactly the changed pixels of the buffer.
+     *
+     * If the compositor does not support damage in buffer coordinates (wl_compositor
+     * version 4), the @p rect gets converted to surface coordinates. With a buffer
+     * transform other than Output::Transform::Normal the whole Surface gets damaged
+     * instead.
+     * @see damage
+     * @see setScale
+     * @since 5.58
+     **/
+    void damageBuffer(const QRect &rect);
+    /**
+     * Mark @p region in buffer coordinates as damaged for the next frame.
+     * @see damageBuffer(const QRect&)
+     * @since 5.58
+     **/
+    void damageBuffer(const QRegion &region);
     /**
      * Attaches the @p buffer to this Surface for the next frame.
      * @param buffer The buffer to attach to this Surface
@@ -227,6 +248,26 @@ public:
      **/
     qint32 scale() const;
 
+    /**
+     * Sets the transformation the client applied to the content of the attached buffers,
+     * e.g. because it renders rotated for an Output with the same @p transform.
+     *
+     * The default transform is Output::Transform::Normal.
+     *
+     * The state is only applied with the next commit.
+     *
+     * @see bufferTransform
+     * @see commit
+     * @since 5.58
+     **/
+    void setBufferTransform(Output::Transform transform);
+    /**
+     * @returns The current buffer transform, if not explicitly set it's Output::Transform::Normal.
+     * @see setBufferTransform
+     * @since 5.58
+     **/
+    Output::Transform bufferTransform() const;
+
     operator wl_surface*();
     operator wl_surface*() const;
 
@@ -21,6 +21,8 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "display.h"
 #include "logging.h"
 #include "surface_interface.h"
+// Qt
+#include <QPointer>
 // Wayland
 #include <wayland-server.h>
 // EGL
@@ -45,12 +47,15 @@ public:
     ~Private();
     QImage::Format format() const;
     QImage createImage();
+    void queryEglBuffer(SurfaceInterface *parent);
     wl_resource *buffer;
     wl_shm_buffer *shmBuffer;
-    SurfaceInterface *surface;
+    QPointer<SurfaceInterface> surface;
     int refCount;
     QSize size;
     bool alpha;
+    QImage::Format imageFormat = QImage::Format_Invalid;
+    bool eglQueried = false;
 
     static BufferInterface *get(wl_resource *r);
 
@@ -58,25 +63,34 @@ private:
     static void destroyListenerCallback(wl_listener *listener, void *data);
     static Private *cast(wl_resource *r);
     static void imageBufferCleanupHandler(void *info);
-    static QList<Private*> s_buffers;
     static Private *s_accessedBuffer;
     static int s_accessCounter;
 
     BufferInterface *q;
-    wl_listener listener;
+    /**
+     * The destroy listener installed on the wl_buffer. The listener is the first member,
+     * so that the Private can be resolved from the listener without any lookup table.
+     **/
+    struct DestroyWrapper {
+        wl_listener listener;
+        Private *buffer;
+    } destroyWrapper;
 };
 
-QList<BufferInterface::Private*> BufferInterface::Private::s_buffers;
 BufferInterface::Private *BufferInterface::Private::s_accessedBuffer = nullptr;
 int BufferInterface::Private::s_accessCounter = 0;
 
 BufferInterface::Private *BufferInterface::Private::cast(wl_resource *r)
 {
-    auto it = std::find_if(s_buffers.constBegin(), s_buffers.constEnd(), [r](Private *d) { return d->buffer == r; });
-    if (it == s_buffers.constEnd()) {
+    if (!r) {
+        return nullptr;
+    }
+    // our destroy listener is unique per wl_buffer, thus it identifies the BufferInterface
+    wl_listener *listener = wl_resource_get_destroy_listener(r, destroyListenerCallback);
+    if (!listener) {
         return nullptr;
     }
-    return *it;
+    return reinterpret_cast<DestroyWrapper*>(listener)->buffer;
 }
 
 BufferInterface *BufferInterface::Private::get(wl_resource *r)
@@ -108,51 +122,62 @@ BufferInterface::Private::Private(BufferInterface *q, wl_resource *resource, Sur
     , alpha(false)
     , q(q)
 {
-    s_buffers << this;
-    listener.notify = destroyListenerCallback;
-    listener.link.prev = nullptr;
-    listener.link.next = nullptr;
-    wl_resource_add_destroy_listener(resource, &listener);
+    destroyWrapper.buffer = this;
+    destroyWrapper.listener.notify = destroyListenerCallback;
+    destroyWrapper.listener.link.prev = nullptr;
+    destroyWrapper.listener.link.next = nullptr;
+    wl_resource_add_destroy_listener(resource, &destroyWrapper.listener);
     if (shmBuffer) {
         size = QSize(wl_shm_buffer_get_width(shmBuffer), wl_shm_buffer_get_height(shmBuffer));
         // check alpha
         switch (wl_shm_buffer_get_format(shmBuffer)) {
         case WL_SHM_FORMAT_ARGB8888:
             alpha = true;
+            imageFormat = QImage::Format_ARGB32_Premultiplied;
             break;
         case WL_SHM_FORMAT_XRGB8888:
+            alpha = false;
+            imageFormat = QImage::Format_RGB32;
+            break;
         default:
             alpha = false;
             break;
         }
     } else if (parent) {
-        EGLDisplay eglDisplay = parent->global()->display()->eglDisplay();
-        static bool resolved = false;
-        using namespace EGL;
-        if (!resolved && eglDisplay != EGL_NO_DISPLAY) {
-            eglQueryWaylandBufferWL = (eglQueryWaylandBufferWL_func)eglGetProcAddress("eglQueryWaylandBufferWL");
-            resolved = true;
+        queryEglBuffer(parent);
+    }
+}
+
+void BufferInterface::Private::queryEglBuffer(SurfaceInterface *parent)
+{
+    // the attributes of a wl_buffer are immutable, so the queries only need to be performed once
+    eglQueried = true;
+    EGLDisplay eglDisplay = parent->global()->display()->eglDisplay();
+    static bool resolved = false;
+    using namespace EGL;
+    if (!resolved && eglDisplay != EGL_NO_DISPLAY) {
+        eglQueryWaylandBufferWL = (eglQueryWaylandBufferWL_func)eglGetProcAddress("eglQueryWaylandBufferWL");
+        resolved = true;
+    }
+    if (eglQueryWaylandBufferWL) {
+        EGLint width, height;
+        bool valid = false;
+        valid = eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_WIDTH, &width);
+        valid = valid && eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_HEIGHT, &height);
+        if (valid) {
+            size = QSize(width, height);
         }
-        if (eglQueryWaylandBufferWL) {
-            EGLint width, height;
-            bool valid = false;
-            valid = eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_WIDTH, &width);
-            valid = valid && eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_HEIGHT, &height);
-            if (valid) {
-                size = QSize(width, height);
-            }
-            // check alpha
-            EGLint format;
-            if (eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_TEXTURE_FORMAT, &format)) {
-                switch (format) {
-                case EGL_TEXTURE_RGBA:
-                    alpha = true;
-                    break;
-                case EGL_TEXTURE_RGB:
-                default:
-                    alpha = false;
-                    break;
-                }
+        // check alpha
+        EGLint format;
+        if (eglQueryWaylandBufferWL(eglDisplay, buffer, EGL_TEXTURE_FORMAT, &format)) {
+            switch (format) {
+            case EGL_TEXTURE_RGBA:
+                alpha = true;
+                break;
+            case EGL_TEXTURE_RGB:
+            default:
+                alpha = false;
+                break;
             }
         }
     }
@@ -160,8 +185,7 @@ BufferInterface::Private::Private(BufferInterface *q, wl_resource *resource, Sur
 
 BufferInterface::Private::~Private()
 {
-    wl_list_remove(&listener.link);
-    s_buffers.removeAll(this);
+    wl_list_remove(&destroyWrapper.listener.link);
 }
 
 BufferInterface *BufferInterface::get(wl_resource *r)
@@ -177,6 +201,17 @@ BufferInterface *BufferInterface::get(wl_resource *r)
     return new BufferInterface(r, nullptr);
 }
 
+void BufferInterface::setSurface(SurfaceInterface *surface)
+{
+    // a wl_buffer can be attached to several surfaces, keep the one holding a reference
+    if (d->refCount == 0 || d->surface.isNull()) {
+        d->surface = surface;
+    }
+    if (!d->shmBuffer && !d->eglQueried && surface) {
+        d->queryEglBuffer(surface);
+    }
+}
+
 BufferInterface::BufferInterface(wl_resource *resource, SurfaceInterface *parent)
     : QObject()
     , d(new Private(this, resource, parent))
@@ -192,8 +227,8 @@ BufferInterface::~BufferInterface()
 
 void BufferInterface::Private::destroyListenerCallback(wl_listener *listener, void *data)
 {
-    Q_UNUSED(listener);
-    auto b = cast(reinterpret_cast<wl_resource*>(data));
+    Q_UNUSED(data)
+    auto b = reinterpret_cast<DestroyWrapper*>(listener)->buffer;
     b->buffer = nullptr;
     emit b->q->aboutToBeDestroyed(b->q);
     delete b->q;
@@ -213,23 +248,12 @@ void BufferInterface::unref()
             wl_buffer_send_release(d->buffer);
             wl_client_flush(wl_resource_get_client(d->buffer));
         }
-        deleteLater();
     }
 }
 
 QImage::Format BufferInterface::Private::format() const
 {
-    if (!shmBuffer) {
-        return QImage::Format_Invalid;
-    }
-    switch (wl_shm_buffer_get_format(shmBuffer)) {
-    case WL_SHM_FORMAT_ARGB8888:
-        return QImage::Format_ARGB32_Premultiplied;
-    case WL_SHM_FORMAT_XRGB8888:
-        return QImage::Format_RGB32;
-    default:
-        return QImage::Format_Invalid;
-    }
+    return imageFormat;
 }
 
 QImage BufferInterface::data()
@@ -267,7 +291,7 @@ bool BufferInterface::isReferenced() const
 
 SurfaceInterface *BufferInterface::surface() const
 {
-    return d->surface;
+    return d->surface.data();
 }
 
 wl_shm_buffer *BufferInterface::shmBuffer()
@@ -41,13 +41,17 @@ class SurfaceInterface;
  * This class encapsulates a rendering buffer which is normally attached to a SurfaceInterface.
  * A client should not render to a Wayland buffer as long as the buffer gets used by the server.
  * The server signals whether it's still used. This class provides a convenience access for this
- * functionality by performing reference counting and deleting the BufferInterface instance
+ * functionality by performing reference counting and releasing the buffer to the client
  * automatically once it is no longer accessed.
  *
  * The BufferInterface is referenced as long as it is attached to a SurfaceInterface. If one wants
  * to keep access to the BufferInterface for a longer time ensure to call ref on first usage and
  * unref again once access to it is no longer needed.
  *
+ * There is exactly one BufferInterface per wl_buffer. It is reused whenever the client attaches
+ * the same wl_buffer again and gets destroyed together with the wl_buffer. Before destruction
+ * the signal aboutToBeDestroyed is emitted.
+ *
  * In Wayland the buffer is an abstract concept and a buffer might represent multiple different
  * concrete buffer techniques. This class has direct support for shared memory buffers built and
  * provides access to the native buffer for different (e.g. EGL/drm) buffers.
@@ -81,8 +85,8 @@ public:
      * Unreference the BufferInterface.
      *
      * If the reference counting reached @c 0 the BufferInterface is released, so that the
-     * client can use it again. The instance of this BufferInterface will be automatically
-     * deleted.
+     * client can use it again. The instance of this BufferInterface stays valid until the
+     * client destroys the wl_buffer, in which case aboutToBeDestroyed is emitted.
      *
      * @see ref
      * @see isReferenced
@@ -98,6 +102,8 @@ public:
 
     /**
      * @returns The SurfaceInterface this BufferInterface is attached to.
+     * If the wl_buffer is attached to several surfaces, it is the one which referenced it
+     * first, as long as the BufferInterface is referenced.
      **/
     SurfaceInterface *surface() const;
     /**
@@ -177,6 +183,7 @@ Q_SIGNALS:
 private:
     friend class SurfaceInterface;
     explicit BufferInterface(wl_resource *resource, SurfaceInterface *parent);
+    void setSurface(SurfaceInterface *surface);
     class Private;
     QScopedPointer<Private> d;
 };
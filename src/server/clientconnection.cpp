@@ -21,9 +21,10 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "display.h"
 // Qt
 #include <QFileInfo>
-#include <QVector>
 // Wayland
 #include <wayland-server.h>
+// system
+#include <sys/ioctl.h>
 
 namespace KWayland
 {
@@ -42,24 +43,32 @@ public:
     uid_t user = 0;
     gid_t group = 0;
     QString executablePath;
+    bool flushScheduled = false;
+    // the last measured unreadBytes, valid till this client or all clients get flushed
+    quint32 unreadBytes = 0;
+    quint64 unreadBytesFlushCycle = 0;
+    bool unreadBytesValid = false;
+    void flush(bool write = true);
 
 private:
     static void destroyListenerCallback(wl_listener *listener, void *data);
     ClientConnection *q;
-    wl_listener listener;
-    static QVector<Private*> s_allClients;
+    // the wl_listener is the first member, so the callback can get back to the Private
+    struct DestroyListener {
+        wl_listener listener;
+        Private *connection;
+    };
+    DestroyListener listener;
 };
 
-QVector<ClientConnection::Private*> ClientConnection::Private::s_allClients;
-
 ClientConnection::Private::Private(wl_client *c, Display *display, ClientConnection *q)
     : client(c)
     , display(display)
     , q(q)
 {
-    s_allClients << this;
-    listener.notify = destroyListenerCallback;
-    wl_client_add_destroy_listener(c, &listener);
+    listener.listener.notify = destroyListenerCallback;
+    listener.connection = this;
+    wl_client_add_destroy_listener(c, &listener.listener);
     wl_client_get_credentials(client, &pid, &user, &group);
     executablePath = QFileInfo(QStringLiteral("/proc/%1/exe").arg(pid)).symLinkTarget();
 }
@@ -67,25 +76,17 @@ ClientConnection::Private::Private(wl_client *c, Display *display, ClientConnect
 ClientConnection::Private::~Private()
 {
     if (client) {
-        wl_list_remove(&listener.link);
+        wl_list_remove(&listener.listener.link);
     }
-    s_allClients.removeAt(s_allClients.indexOf(this));
 }
 
 void ClientConnection::Private::destroyListenerCallback(wl_listener *listener, void *data)
 {
-    Q_UNUSED(listener)
-    wl_client *client = reinterpret_cast<wl_client*>(data);
-    auto it = std::find_if(s_allClients.constBegin(), s_allClients.constEnd(),
-        [client](Private *c) {
-            return c->client == client;
-        }
-    );
-    Q_ASSERT(it != s_allClients.constEnd());
-    auto p = (*it);
+    auto p = reinterpret_cast<DestroyListener*>(listener)->connection;
+    Q_ASSERT(p->client == reinterpret_cast<wl_client*>(data));
     auto q = p->q;
     p->client = nullptr;
-    wl_list_remove(&p->listener.link);
+    wl_list_remove(&p->listener.listener.link);
     emit q->disconnected(q);
     q->deleteLater();
 }
@@ -98,12 +99,67 @@ ClientConnection::ClientConnection(wl_client *c, Display *parent)
 
 ClientConnection::~ClientConnection() = default;
 
+quint32 ClientConnection::unreadBytes() const
+{
+    if (!d->client) {
+        return 0;
+    }
+    // events only get added to the queue by a flush, so it is measured once per flush
+    // instead of issuing an ioctl for each motion event
+    const quint64 flushCycle = d->display->flushCycle();
+    if (d->unreadBytesValid && d->unreadBytesFlushCycle == flushCycle) {
+        return d->unreadBytes;
+    }
+    d->unreadBytes = 0;
+#ifdef TIOCOUTQ
+    int bytes = 0;
+    if (ioctl(wl_client_get_fd(d->client), TIOCOUTQ, &bytes) == 0 && bytes > 0) {
+        d->unreadBytes = bytes;
+    }
+#endif
+    d->unreadBytesFlushCycle = flushCycle;
+    d->unreadBytesValid = true;
+    return d->unreadBytes;
+}
+
+void ClientConnection::Private::flush(bool write)
+{
+    flushScheduled = false;
+    unreadBytesValid = false;
+    if (write) {
+        wl_client_flush(client);
+    }
+}
+
 void ClientConnection::flush()
 {
     if (!d->client) {
         return;
     }
-    wl_client_flush(d->client);
+    if (d->display->flushPolicy() == Display::FlushPolicy::Deferred) {
+        if (!d->flushScheduled) {
+            d->flushScheduled = true;
+            d->display->scheduleFlush(this);
+        }
+        return;
+    }
+    d->flush();
+}
+
+void ClientConnection::flushUrgent()
+{
+    if (!d->client) {
+        return;
+    }
+    d->flush();
+}
+
+void ClientConnection::flushDeferred(bool write)
+{
+    if (!d->client || !d->flushScheduled) {
+        return;
+    }
+    d->flush(write);
 }
 
 void ClientConnection::destroy()
@@ -54,8 +54,23 @@ public:
 
     /**
      * Flushes the connection to this client. Ensures that all events are pushed to the client.
+     *
+     * With the Display::FlushPolicy::Deferred the connection is only marked to be flushed
+     * at the end of the current dispatch cycle of the Display.
+     *
+     * @see flushUrgent
+     * @see Display::setFlushPolicy
      **/
     void flush();
+    /**
+     * Flushes the connection to this client right away regardless of the Display::FlushPolicy.
+     *
+     * Intended for latency sensitive events like input events.
+     *
+     * @see flush
+     * @since 5.58
+     **/
+    void flushUrgent();
     /**
      * Creates a new wl_resource for the provided @p interface.
      *
@@ -123,6 +138,25 @@ public:
      **/
     QString executablePath() const;
 
+    /**
+     * The number of bytes of events already sent to this client which the client did not
+     * read yet.
+     *
+     * A client which stops reading its connection accumulates unread events. Once the
+     * socket buffer is full further events are queued in the server till the client gets
+     * disconnected for a full buffer.
+     *
+     * This is the send queue of the socket as reported by the kernel, which includes the
+     * bookkeeping overhead of the socket buffers. Events which are still buffered in the
+     * server because the connection did not get flushed yet are not included. The queue
+     * is measured once after each flush of this client or of all clients at the end of a
+     * dispatch cycle, further calls return the same value.
+     *
+     * @returns The number of unread bytes or @c 0 if it cannot be determined.
+     * @since 5.58
+     **/
+    quint32 unreadBytes() const;
+
     /**
      * Cast operator the native wl_client this ClientConnection represents.
      **/
@@ -150,6 +184,11 @@ Q_SIGNALS:
 private:
     friend class Display;
     explicit ClientConnection(wl_client *c, Display *parent);
+    /**
+     * Flushes the connection if a flush got deferred, called by the Display.
+     * With @p write being @c false the Display writes the pending events itself.
+     **/
+    void flushDeferred(bool write);
     class Private;
     QScopedPointer<Private> d;
 };
@@ -45,6 +45,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "slide_interface.h"
 #include "shell_interface.h"
 #include "subcompositor_interface.h"
+#include "surface_interface_p.h"
 #include "textinput_interface_p.h"
 #include "xdgshell_v5_interface_p.h"
 #include "xdgforeign_interface.h"
@@ -58,9 +59,11 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
 #include <QAbstractEventDispatcher>
 #include <QSocketNotifier>
 #include <QThread>
+#include <QVarLengthArray>
 
 #include <wayland-server.h>
 
@@ -76,6 +79,7 @@ class Display::Private
 public:
     Private(Display *q);
     void flush();
+    void flushScheduledClients(bool write);
     void dispatch();
     void setRunning(bool running);
     void installSocketNotifier();
@@ -89,6 +93,14 @@ public:
     QList<OutputDeviceInterface*> outputdevices;
     QVector<SeatInterface*> seats;
     QVector<ClientConnection*> clients;
+    // the connections by their wl_client for the lookup in getConnection
+    QHash<wl_client*, ClientConnection*> clientConnections;
+    int frameRenderedFlushCount = 0;
+    FlushPolicy flushPolicy = FlushPolicy::Immediate;
+    // the clients to flush at the end of the dispatch cycle
+    QVector<ClientConnection*> scheduledFlushes;
+    // incremented whenever all clients get flushed at the end of the dispatch cycle
+    quint64 flushCycle = 0;
     EGLDisplay eglDisplay = EGL_NO_DISPLAY;
 
 private:
@@ -135,9 +147,24 @@ void Display::Private::flush()
     if (!display || !loop) {
         return;
     }
+    flushCycle++;
+    // the scheduled clients are written by the single pass over all clients below
+    flushScheduledClients(false);
+    // this pass cannot be skipped, most events are sent without ClientConnection::flush and only
+    // get written here. libwayland only writes to clients with pending events
     wl_display_flush_clients(display);
 }
 
+void Display::Private::flushScheduledClients(bool write)
+{
+    // a flushed client might schedule another flush, e.g. from a disconnect
+    const auto clients = std::move(scheduledFlushes);
+    scheduledFlushes.clear();
+    for (ClientConnection *c : clients) {
+        c->flushDeferred(write);
+    }
+}
+
 void Display::Private::dispatch()
 {
     if (!display || !loop) {
@@ -218,7 +245,7 @@ void Display::dispatchEvents(int msecTimeout)
         d->dispatch();
     } else if (d->loop) {
         wl_event_loop_dispatch(d->loop, msecTimeout);
-        wl_display_flush_clients(d->display);
+        d->flush();
     }
 }
 
@@ -575,23 +602,20 @@ QVector<SeatInterface*> Display::seats() const
 ClientConnection *Display::getConnection(wl_client *client)
 {
     Q_ASSERT(client);
-    auto it = std::find_if(d->clients.constBegin(), d->clients.constEnd(),
-        [client](ClientConnection *c) {
-            return c->client() == client;
-        }
-    );
-    if (it != d->clients.constEnd()) {
-        return *it;
+    if (ClientConnection *c = d->clientConnections.value(client)) {
+        return c;
     }
     // no ConnectionData yet, create it
     auto c = new ClientConnection(client, this);
     d->clients << c;
+    d->clientConnections.insert(client, c);
     connect(c, &ClientConnection::disconnected, this,
-        [this] (ClientConnection *c) {
-            const int index = d->clients.indexOf(c);
-            Q_ASSERT(index != -1);
-            d->clients.remove(index);
-            Q_ASSERT(d->clients.indexOf(c) == -1);
+        [this, client] (ClientConnection *c) {
+            // the wl_client gets freed and its address might be reused by the next client
+            d->clientConnections.remove(client);
+            d->scheduledFlushes.removeOne(c);
+            const bool removed = d->clients.removeOne(c);
+            Q_ASSERT(removed);
             emit clientDisconnected(c);
         }
     );
@@ -604,6 +628,59 @@ QVector< ClientConnection* > Display::connections() const
     return d->clients;
 }
 
+void Display::frameRendered(const QVector<SurfaceInterface*> &surfaces, quint32 msec)
+{
+    // first send all callbacks, then flush each client only once
+    QVarLengthArray<ClientConnection*, 16> dirtyClients;
+    for (SurfaceInterface *surface : surfaces) {
+        if (!surface) {
+            continue;
+        }
+        if (!surface->d_func()->sendFrameCallbacks(msec)) {
+            continue;
+        }
+        ClientConnection *c = surface->client();
+        if (c && !dirtyClients.contains(c)) {
+            dirtyClients.append(c);
+        }
+    }
+    for (ClientConnection *c : dirtyClients) {
+        c->flush();
+    }
+    d->frameRenderedFlushCount = dirtyClients.count();
+}
+
+int Display::frameRenderedFlushCount() const
+{
+    return d->frameRenderedFlushCount;
+}
+
+void Display::setFlushPolicy(FlushPolicy policy)
+{
+    if (d->flushPolicy == policy) {
+        return;
+    }
+    d->flushPolicy = policy;
+    if (policy == FlushPolicy::Immediate) {
+        d->flushScheduledClients(true);
+    }
+}
+
+Display::FlushPolicy Display::flushPolicy() const
+{
+    return d->flushPolicy;
+}
+
+void Display::scheduleFlush(ClientConnection *client)
+{
+    d->scheduledFlushes << client;
+}
+
+quint64 Display::flushCycle() const
+{
+    return d->flushCycle;
+}
+
 ClientConnection *Display::createClient(int fd)
 {
     Q_ASSERT(fd != -1);
@@ -73,6 +73,7 @@ class ServerSideDecorationManagerInterface;
 class SlideManagerInterface;
 class ShellInterface;
 class SubCompositorInterface;
+class SurfaceInterface;
 enum class TextInputInterfaceVersion;
 class TextInputManagerInterface;
 class XdgShellV5Interface;
@@ -311,6 +312,63 @@ public:
     ClientConnection *getConnection(wl_client *client);
     QVector<ClientConnection*> connections() const;
 
+    /**
+     * Notifies the frame callbacks of all @p surfaces and their sub-surfaces that a frame
+     * got rendered at @p msec.
+     *
+     * In contrast to calling SurfaceInterface::frameRendered for each of the @p surfaces this
+     * flushes each ClientConnection only once after all callbacks got sent. A compositor should
+     * pass all surfaces presented in one frame on an output.
+     *
+     * @see SurfaceInterface::frameRendered
+     * @see frameRenderedFlushCount
+     * @since 5.58
+     **/
+    void frameRendered(const QVector<SurfaceInterface*> &surfaces, quint32 msec);
+    /**
+     * @returns The number of ClientConnections flushed in the last call to frameRendered.
+     * @see frameRendered
+     * @since 5.58
+     **/
+    int frameRenderedFlushCount() const;
+
+    /**
+     * How ClientConnection::flush gets handled.
+     * @see setFlushPolicy
+     * @since 5.58
+     **/
+    enum class FlushPolicy {
+        /**
+         * ClientConnection::flush writes the pending events to the client right away.
+         **/
+        Immediate,
+        /**
+         * ClientConnection::flush only marks the ClientConnection. Each marked ClientConnection
+         * gets flushed once at the end of the dispatch cycle, that is when the event loop is about
+         * to block or at the end of dispatchEvents, in the same pass which writes the pending
+         * events of all other clients. ClientConnection::flushUrgent
+         * still flushes right away, it is used for input events.
+         **/
+        Deferred
+    };
+    /**
+     * Sets the @p policy for flushing ClientConnections.
+     *
+     * The default is FlushPolicy::Immediate. With many clients FlushPolicy::Deferred reduces
+     * the number of writes to the client sockets as the events of a dispatch cycle are sent at
+     * once. Switching back to FlushPolicy::Immediate flushes the marked ClientConnections.
+     *
+     * @see flushPolicy
+     * @since 5.58
+     **/
+    void setFlushPolicy(FlushPolicy policy);
+    /**
+     * @returns The current FlushPolicy
+     * @see setFlushPolicy
+     * @since 5.58
+     **/
+    FlushPolicy flushPolicy() const;
+
     /**
      * Set the EGL @p display for this Wayland display.
      * The EGLDisplay can only be set once and must be alive as long as the Wayland display
@@ -337,6 +395,9 @@ Q_SIGNALS:
     void clientDisconnected(KWayland::Server::ClientConnection*);
 
 private:
+    friend class ClientConnection;
+    void scheduleFlush(ClientConnection *client);
+    quint64 flushCycle() const;
     class Private;
     QScopedPointer<Private> d;
 };
@@ -20,10 +20,12 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "filtered_display.h"
 #include "display.h"
+#include "clientconnection.h"
 
 #include <wayland-server.h>
 
 #include <QByteArray>
+#include <QHash>
 
 namespace KWayland
 {
@@ -35,13 +37,23 @@ class FilteredDisplay::Private
 public:
     Private(FilteredDisplay *_q);
     FilteredDisplay *q;
+    // the allowInterface results by client and interface
+    QHash<ClientConnection*, QHash<const wl_interface*, bool>> allowedInterfaces;
     static bool globalFilterCallback(const wl_client *client, const wl_global *global, void *data)
     {
         auto t = static_cast<FilteredDisplay::Private*>(data);
         auto clientConnection = t->q->getConnection(const_cast<wl_client*>(client));
         auto interface = wl_global_get_interface(global);
+        const auto &clientInterfaces = t->allowedInterfaces[clientConnection];
+        auto it = clientInterfaces.constFind(interface);
+        if (it != clientInterfaces.constEnd()) {
+            return *it;
+        }
         auto name = QByteArray::fromRawData(interface->name, strlen(interface->name));
-        return t->q->allowInterface(clientConnection, name);
+        const bool allowed = t->q->allowInterface(clientConnection, name);
+        // allowInterface might have invalidated the cache, don't hold on to the previous lookup
+        t->allowedInterfaces[clientConnection].insert(interface, allowed);
+        return allowed;
     };
 };
 
@@ -60,11 +72,24 @@ FilteredDisplay::FilteredDisplay(QObject *parent):
         }
         wl_display_set_global_filter(*this, Private::globalFilterCallback, d.data());
     });
+    connect(this, &Display::clientDisconnected, this, [this](ClientConnection *client) {
+        d->allowedInterfaces.remove(client);
+    });
 }
 
 FilteredDisplay::~FilteredDisplay()
 {
 }
 
+void FilteredDisplay::invalidateInterfaceFilter(ClientConnection *client)
+{
+    d->allowedInterfaces.remove(client);
+}
+
+void FilteredDisplay::invalidateInterfaceFilter()
+{
+    d->allowedInterfaces.clear();
+}
+
 }
 }
@@ -51,9 +51,26 @@ public:
 * When false will not see these globals for a given interface in the registry,
 * and any manual attempts to bind will fail
 *
+* The result is cached per client and interface. Call invalidateInterfaceFilter
+* when the policy for a client changes.
+*
 * @return true if the client should be able to access the global with the following interfaceName
 */
     virtual bool allowInterface(ClientConnection *client, const QByteArray &interfaceName) = 0;
+
+/**
+* Discards the cached allowInterface results for @arg client, so that allowInterface
+* gets called again the next time the client accesses the registry.
+*
+* @since 5.58
+*/
+    void invalidateInterfaceFilter(ClientConnection *client);
+/**
+* Discards the cached allowInterface results for all clients.
+*
+* @since 5.58
+*/
+    void invalidateInterfaceFilter();
 private:
     class Private;
     QScopedPointer<Private> d;
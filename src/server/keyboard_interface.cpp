@@ -134,7 +134,7 @@ void KeyboardInterface::setFocusedSurface(SurfaceInterface *surface, quint32 ser
     d->focusedChildSurface = QPointer<SurfaceInterface>(surface);
 
     d->sendEnter(d->focusedSurface, serial);
-    d->client->flush();
+    d->client->flushUrgent();
 }
 
 void KeyboardInterface::keyPressed(quint32 key, quint32 serial)
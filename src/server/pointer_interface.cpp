@@ -24,6 +24,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "resource_p.h"
 #include "relativepointer_interface_p.h"
 #include "seat_interface.h"
+#include "seat_interface_p.h"
 #include "display.h"
 #include "subcompositor_interface.h"
 #include "surface_interface.h"
@@ -84,9 +85,11 @@ void PointerInterface::Private::sendLeave(SurfaceInterface *surface, quint32 ser
 void PointerInterface::Private::registerRelativePointer(RelativePointerInterface *relativePointer)
 {
     relativePointers << relativePointer;
+    seat->d_func()->invalidatePointerTargets();
     QObject::connect(relativePointer, &QObject::destroyed, q,
         [this, relativePointer] {
             relativePointers.removeOne(relativePointer);
+            seat->d_func()->invalidatePointerTargets();
         }
     );
 }
@@ -95,9 +98,11 @@ void PointerInterface::Private::registerRelativePointer(RelativePointerInterface
 void PointerInterface::Private::registerSwipeGesture(PointerSwipeGestureInterface *gesture)
 {
     swipeGestures << gesture;
+    seat->d_func()->invalidatePointerTargets();
     QObject::connect(gesture, &QObject::destroyed, q,
         [this, gesture] {
             swipeGestures.removeOne(gesture);
+            seat->d_func()->invalidatePointerTargets();
         }
     );
 }
@@ -105,9 +110,11 @@ void PointerInterface::Private::registerSwipeGesture(PointerSwipeGestureInterfac
 void PointerInterface::Private::registerPinchGesture(PointerPinchGestureInterface *gesture)
 {
     pinchGestures << gesture;
+    seat->d_func()->invalidatePointerTargets();
     QObject::connect(gesture, &QObject::destroyed, q,
         [this, gesture] {
             pinchGestures.removeOne(gesture);
+            seat->d_func()->invalidatePointerTargets();
         }
     );
 }
@@ -217,6 +224,10 @@ void PointerInterface::Private::sendFrame()
     if (!resource || wl_resource_get_version(resource) < WL_POINTER_FRAME_SINCE_VERSION) {
         return;
     }
+    if (frameDeferred) {
+        framePending = true;
+        return;
+    }
     wl_pointer_send_frame(resource);
 }
 
@@ -227,45 +238,60 @@ const struct wl_pointer_interface PointerInterface::Private::s_interface = {
 };
 #endif
 
-PointerInterface::PointerInterface(SeatInterface *parent, wl_resource *parentResource)
-    : Resource(new Private(parent, parentResource, this))
+void PointerInterface::Private::setFocusedChildSurface(SurfaceInterface *surface)
+{
+    focusedChildSurface = QPointer<SurfaceInterface>(surface);
+    focusedChildSurfaceOffsetValid = false;
+}
+
+QPointF PointerInterface::Private::focusedChildSurfacePosition()
+{
+    if (!focusedChildSurfaceOffsetValid) {
+        focusedChildSurfaceOffset = surfacePosition(focusedChildSurface);
+        focusedChildSurfaceOffsetValid = true;
+    }
+    return focusedChildSurfaceOffset;
+}
+
+void PointerInterface::Private::updatePosition(const QPointF &pos)
 {
     // TODO: handle touch
-    connect(parent, &SeatInterface::pointerPosChanged, this, [this] {
-        Q_D();
-        if (!d->focusedSurface || !d->resource) {
-            return;
-        }
-        if (d->seat->isDragPointer()) {
-            const auto *originSurface = d->seat->dragSource()->origin();
-            const bool proxyRemoteFocused = originSurface->dataProxy() && originSurface == d->focusedSurface;
-            if (!proxyRemoteFocused) {
-                // handled by DataDevice
-                return;
-            }
-        }
-        if (!d->focusedSurface->lockedPointer().isNull() && d->focusedSurface->lockedPointer()->isLocked()) {
+    if (!focusedSurface || !resource) {
+        return;
+    }
+    if (seat->isDragPointer()) {
+        const auto *originSurface = seat->dragSource()->origin();
+        const bool proxyRemoteFocused = originSurface->dataProxy() && originSurface == focusedSurface;
+        if (!proxyRemoteFocused) {
+            // handled by DataDevice
             return;
         }
-        const QPointF pos = d->seat->focusedPointerSurfaceTransformation().map(d->seat->pointerPos());
-        auto targetSurface = d->focusedSurface->inputSurfaceAt(pos);
-        if (!targetSurface) {
-            targetSurface = d->focusedSurface;
-        }
-        if (targetSurface != d->focusedChildSurface.data()) {
-            const quint32 serial = d->seat->display()->nextSerial();
-            d->sendLeave(d->focusedChildSurface.data(), serial);
-            d->focusedChildSurface = QPointer<SurfaceInterface>(targetSurface);
-            d->sendEnter(targetSurface, pos, serial);
-            d->sendFrame();
-            d->client->flush();
-        } else {
-            const QPointF adjustedPos = pos - surfacePosition(d->focusedChildSurface);
-            wl_pointer_send_motion(d->resource, d->seat->timestamp(),
-                                   wl_fixed_from_double(adjustedPos.x()), wl_fixed_from_double(adjustedPos.y()));
-            d->sendFrame();
-        }
-    });
+    }
+    if (!focusedSurface->lockedPointer().isNull() && focusedSurface->lockedPointer()->isLocked()) {
+        return;
+    }
+    auto targetSurface = focusedSurface->inputSurfaceAt(pos);
+    if (!targetSurface) {
+        targetSurface = focusedSurface;
+    }
+    if (targetSurface != focusedChildSurface.data()) {
+        const quint32 serial = seat->display()->nextSerial();
+        sendLeave(focusedChildSurface.data(), serial);
+        setFocusedChildSurface(targetSurface);
+        sendEnter(targetSurface, pos, serial);
+        sendFrame();
+        client->flushUrgent();
+    } else {
+        const QPointF adjustedPos = pos - focusedChildSurfacePosition();
+        wl_pointer_send_motion(resource, seat->timestamp(),
+                               wl_fixed_from_double(adjustedPos.x()), wl_fixed_from_double(adjustedPos.y()));
+        sendFrame();
+    }
+}
+
+PointerInterface::PointerInterface(SeatInterface *parent, wl_resource *parentResource)
+    : Resource(new Private(parent, parentResource, this))
+{
 }
 
 PointerInterface::~PointerInterface() = default;
@@ -275,9 +301,10 @@ void PointerInterface::setFocusedSurface(SurfaceInterface *surface, quint32 seri
     Q_D();
     d->sendLeave(d->focusedChildSurface.data(), serial);
     disconnect(d->destroyConnection);
+    disconnect(d->subSurfaceTreeConnection);
     if (!surface) {
         d->focusedSurface = nullptr;
-        d->focusedChildSurface.clear();
+        d->setFocusedChildSurface(nullptr);
         return;
     }
     d->focusedSurface = surface;
@@ -287,17 +314,22 @@ void PointerInterface::setFocusedSurface(SurfaceInterface *surface, quint32 seri
             d->sendLeave(d->focusedChildSurface.data(), d->global->display()->nextSerial());
             d->sendFrame();
             d->focusedSurface = nullptr;
-            d->focusedChildSurface.clear();
+            d->setFocusedChildSurface(nullptr);
+        }
+    );
+    // sub-surfaces got moved, added or removed
+    d->subSurfaceTreeConnection = connect(d->focusedSurface, &SurfaceInterface::subSurfaceTreeChanged, this,
+        [this] {
+            Q_D();
+            d->focusedChildSurfaceOffsetValid = false;
         }
     );
 
     const QPointF pos = d->seat->focusedPointerSurfaceTransformation().map(d->seat->pointerPos());
-    d->focusedChildSurface = QPointer<SurfaceInterface>(d->focusedSurface->inputSurfaceAt(pos));
-    if (!d->focusedChildSurface) {
-        d->focusedChildSurface = QPointer<SurfaceInterface>(d->focusedSurface);
-    }
+    auto childSurface = d->focusedSurface->inputSurfaceAt(pos);
+    d->setFocusedChildSurface(childSurface ? childSurface : d->focusedSurface);
     d->sendEnter(d->focusedChildSurface.data(), pos, serial);
-    d->client->flush();
+    d->client->flushUrgent();
 }
 
 void PointerInterface::buttonPressed(quint32 button, quint32 serial)
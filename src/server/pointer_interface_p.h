@@ -42,7 +42,14 @@ public:
     SurfaceInterface *focusedSurface = nullptr;
     QPointer<SurfaceInterface> focusedChildSurface;
     QMetaObject::Connection destroyConnection;
+    QMetaObject::Connection subSurfaceTreeConnection;
+    // position of the focusedChildSurface in the focusedSurface, reset when the tree changes
+    QPointF focusedChildSurfaceOffset;
+    bool focusedChildSurfaceOffsetValid = false;
     Cursor *cursor = nullptr;
+    // set by the SeatInterface during an input frame, the frame event is sent at its end
+    bool frameDeferred = false;
+    bool framePending = false;
     QVector<RelativePointerInterface*> relativePointers;
     QVector<PointerSwipeGestureInterface*> swipeGestures;
     QVector<PointerPinchGestureInterface*> pinchGestures;
@@ -50,6 +57,14 @@ public:
     void sendLeave(SurfaceInterface *surface, quint32 serial);
     void sendEnter(SurfaceInterface *surface, const QPointF &parentSurfacePosition, quint32 serial);
     void sendFrame();
+    /**
+     * Sends the pointer position @p pos in coordinates of the focused surface, entering
+     * a different sub-surface if needed.
+     * Only invoked by the SeatInterface on the pointers of the focused client.
+     **/
+    void updatePosition(const QPointF &pos);
+    void setFocusedChildSurface(SurfaceInterface *surface);
+    QPointF focusedChildSurfacePosition();
 
     void registerRelativePointer(RelativePointerInterface *relativePointer);
     void registerSwipeGesture(PointerSwipeGestureInterface *gesture);
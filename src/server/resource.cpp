@@ -28,7 +28,7 @@ namespace KWayland
 namespace Server
 {
 
-QList<Resource::Private*> Resource::Private::s_allResources;
+QHash<wl_resource*, Resource::Private*> Resource::Private::s_allResources;
 
 Resource::Private::Private(Resource *q, Global *g, wl_resource *parentResource, const wl_interface *interface, const void *implementation)
     : parentResource(parentResource)
@@ -37,13 +37,12 @@ Resource::Private::Private(Resource *q, Global *g, wl_resource *parentResource,
     , m_interface(interface)
     , m_interfaceImplementation(implementation)
 {
-    s_allResources << this;
 }
 
 Resource::Private::~Private()
 {
-    s_allResources.removeAll(this);
     if (resource) {
+        s_allResources.remove(resource);
         wl_resource_destroy(resource);
     }
 }
@@ -57,6 +56,7 @@ void Resource::Private::create(ClientConnection *c, quint32 version, quint32 id)
     if (!resource) {
         return;
     }
+    s_allResources.insert(resource, this);
     wl_resource_set_implementation(resource, m_interfaceImplementation, this, unbind);
 }
 
@@ -64,6 +64,7 @@ void Resource::Private::unbind(wl_resource *r)
 {
     Private *p = cast<Private>(r);
     emit p->q->aboutToBeUnbound();
+    s_allResources.remove(r);
     p->resource = nullptr;
     emit p->q->unbound();
     p->q->deleteLater();
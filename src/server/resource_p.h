@@ -21,6 +21,8 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #define WAYLAND_SERVER_RESOURCE_P_H
 
 #include "resource.h"
+#include "clientconnection.h"
+#include <QHash>
 #include <wayland-server.h>
 #include <type_traits>
 
@@ -47,29 +49,29 @@ public:
         if (!native) {
             return nullptr;
         }
-        auto it = std::find_if(s_allResources.constBegin(), s_allResources.constEnd(),
-            [native](Private *p) {
-                return p->resource == native;
-            }
-        );
-        if (it == s_allResources.constEnd()) {
+        Private *p = s_allResources.value(native, nullptr);
+        if (!p) {
             return nullptr;
         }
-        return reinterpret_cast<ResourceDerived*>((*it)->q);
+        return reinterpret_cast<ResourceDerived*>(p->q);
     }
     template <typename ResourceDerived>
     static ResourceDerived *get(quint32 id, const ClientConnection *c) {
         static_assert(std::is_base_of<Resource, ResourceDerived>::value,
                       "ResourceDerived must be derived from Resource");
-        auto it = std::find_if(s_allResources.constBegin(), s_allResources.constEnd(),
-            [id, c](Private *p) {
-                return c == p->client && p->resource && wl_resource_get_id(p->resource) == id;
-            }
-        );
-        if (it == s_allResources.constEnd()) {
+        if (!c) {
             return nullptr;
         }
-        return reinterpret_cast<ResourceDerived*>((*it)->q);
+        wl_client *client = *c;
+        if (!client) {
+            return nullptr;
+        }
+        // the id is only unique per client, resolve it through libwayland's per client object map
+        Private *p = s_allResources.value(wl_client_get_object(client, id), nullptr);
+        if (!p || p->client != c) {
+            return nullptr;
+        }
+        return reinterpret_cast<ResourceDerived*>(p->q);
     }
 
 protected:
@@ -85,7 +87,11 @@ protected:
     static void resourceDestroyedCallback(wl_client *client, wl_resource *resource);
 
     Resource *q;
-    static QList<Private*> s_allResources;
+    /**
+     * All created Resources indexed by their native wl_resource.
+     * Entries are added in create and removed once the wl_resource gets destroyed.
+     **/
+    static QHash<wl_resource*, Private*> s_allResources;
 
 private:
     const wl_interface *const m_interface;
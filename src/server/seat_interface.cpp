@@ -26,8 +26,15 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "keyboard_interface_p.h"
 #include "pointer_interface.h"
 #include "pointer_interface_p.h"
+#include "pointergestures_interface_p.h"
+#include "relativepointer_interface_p.h"
 #include "surface_interface.h"
 #include "textinput_interface_p.h"
+#include "clientconnection.h"
+#include "logging.h"
+// Qt
+#include <QCryptographicHash>
+#include <QTemporaryFile>
 // Wayland
 #ifndef WL_SEAT_NAME_SINCE_VERSION
 #define WL_SEAT_NAME_SINCE_VERSION 2
@@ -37,8 +44,11 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #if HAVE_LINUX_INPUT_H
 #include <linux/input.h>
 #endif
-
-#include <functional>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 
 namespace KWayland
 {
@@ -50,11 +60,33 @@ const quint32 SeatInterface::Private::s_version = 5;
 const qint32 SeatInterface::Private::s_pointerVersion = 5;
 const qint32 SeatInterface::Private::s_touchVersion = 5;
 const qint32 SeatInterface::Private::s_keyboardVersion = 5;
+constexpr quint32 SeatInterface::Private::s_keyCount;
+constexpr qint32 SeatInterface::Private::s_touchSlotCount;
+constexpr quint32 SeatInterface::Private::s_inputQueueSize;
+const int SeatInterface::Private::s_keymapCacheSize = 4;
+const quint32 SeatInterface::Private::s_backlogThreshold = 32 * 1024;
+const int SeatInterface::Private::s_backlogRetryInterval = 10;
 
 SeatInterface::Private::Private(SeatInterface *q, Display *display)
     : Global::Private(display, &wl_seat_interface, s_version)
     , q(q)
 {
+    inputQueue.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (inputQueue.fd == -1) {
+        qCWarning(KWAYLAND_SERVER) << "Could not create the eventfd for the input queue";
+    }
+    inputQueue.touchIds.fill(-1);
+}
+
+SeatInterface::Private::~Private()
+{
+    removeInputQueueSource();
+    if (inputQueue.fd != -1) {
+        close(inputQueue.fd);
+    }
+    for (const auto &file : qAsConst(keys.keymapCache)) {
+        close(file.fd);
+    }
 }
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -85,6 +117,18 @@ SeatInterface::SeatInterface(Display *display, QObject *parent)
     connect(this, &SeatInterface::hasPointerChanged,  this, sendCapabilitiesAll);
     connect(this, &SeatInterface::hasKeyboardChanged, this, sendCapabilitiesAll);
     connect(this, &SeatInterface::hasTouchChanged,    this, sendCapabilitiesAll);
+    // the input queue is drained by the event loop of the Display
+    if (display->isRunning()) {
+        d->addInputQueueSource();
+    }
+    connect(display, &Display::runningChanged, this,
+        [d] (bool running) {
+            if (running) {
+                d->addInputQueueSource();
+            }
+        }
+    );
+    connect(display, &Display::aboutToTerminate, this, [d] { d->removeInputQueueSource(); });
 }
 
 SeatInterface::~SeatInterface()
@@ -123,38 +167,476 @@ void SeatInterface::Private::releaseCallback(wl_client *client, wl_resource *res
 
 void SeatInterface::Private::updatePointerButtonSerial(quint32 button, quint32 serial)
 {
-    auto it = globalPointer.buttonSerials.find(button);
-    if (it == globalPointer.buttonSerials.end()) {
-        globalPointer.buttonSerials.insert(button, serial);
+    if (button >= s_keyCount) {
         return;
     }
-    it.value() = serial;
+    globalPointer.buttonSerials[button] = serial;
 }
 
 void SeatInterface::Private::updatePointerButtonState(quint32 button, Pointer::State state)
 {
-    auto it = globalPointer.buttonStates.find(button);
-    if (it == globalPointer.buttonStates.end()) {
-        globalPointer.buttonStates.insert(button, state);
+    if (button >= s_keyCount) {
         return;
     }
-    it.value() = state;
+    const bool pressed = state == Pointer::State::Pressed;
+    if (globalPointer.buttonStates.test(button) == pressed) {
+        return;
+    }
+    globalPointer.buttonStates.set(button, pressed);
+    if (pressed) {
+        globalPointer.pressedButtons << button;
+    } else {
+        globalPointer.pressedButtons.removeOne(button);
+    }
+}
+
+namespace {
+bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+int createKeymapFile(const QByteArray &content)
+{
+    // xkbcommon expects the keymap to be null terminated
+    const size_t size = content.size() + 1;
+#if HAVE_MEMFD
+    int fd = memfd_create("kwayland-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        if (!writeAll(fd, content.constData(), size)) {
+            close(fd);
+            return -1;
+        }
+        // neither the compositor nor any client may change the keymap after it got announced
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        return fd;
+    }
+    qCDebug(KWAYLAND_SERVER) << "Could not create memfd for keymap, falling back to temporary file";
+#endif
+    QTemporaryFile tmp;
+    if (!tmp.open()) {
+        qCWarning(KWAYLAND_SERVER) << "Could not open temporary file for keymap";
+        return -1;
+    }
+    if (!writeAll(tmp.handle(), content.constData(), size)) {
+        qCWarning(KWAYLAND_SERVER) << "Could not write keymap to temporary file";
+        return -1;
+    }
+    // the duplicate keeps the unlinked file alive
+    return fcntl(tmp.handle(), F_DUPFD_CLOEXEC, 0);
+}
+}
+
+SeatInterface::Private::Keyboard::KeymapFile SeatInterface::Private::keymapFile(const QByteArray &content)
+{
+    const QByteArray hash = QCryptographicHash::hash(content, QCryptographicHash::Sha1);
+    for (auto it = keys.keymapCache.begin(); it != keys.keymapCache.end(); ++it) {
+        if (it->hash == hash) {
+            const Keyboard::KeymapFile file = *it;
+            keys.keymapCache.erase(it);
+            keys.keymapCache << file;
+            return file;
+        }
+    }
+    Keyboard::KeymapFile file;
+    file.fd = createKeymapFile(content);
+    if (file.fd == -1) {
+        return file;
+    }
+    file.hash = hash;
+    file.size = content.size() + 1;
+    if (keys.keymapCache.count() == s_keymapCacheSize) {
+        // the current keymap is the most recently used one, thus never evicted
+        close(keys.keymapCache.takeFirst().fd);
+    }
+    keys.keymapCache << file;
+    return file;
+}
+
+void SeatInterface::Private::sendKeymap(KeyboardInterface *keyboard)
+{
+    if (!keys.keymap.shared) {
+        keyboard->setKeymap(keys.keymap.fd, keys.keymap.size);
+        return;
+    }
+    // every client gets its own read-only file description of the sealed file
+    const QByteArray path = QByteArrayLiteral("/proc/self/fd/") + QByteArray::number(keys.keymap.fd);
+    const int fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        keyboard->setKeymap(keys.keymap.fd, keys.keymap.size);
+        return;
+    }
+    keyboard->setKeymap(fd, keys.keymap.size);
+    // libwayland duplicated the file descriptor for sending
+    close(fd);
 }
 
 bool SeatInterface::Private::updateKey(quint32 key, Keyboard::State state)
 {
-    auto it = keys.states.find(key);
-    if (it == keys.states.end()) {
-        keys.states.insert(key, state);
+    if (key >= s_keyCount) {
+        // not tracked, just forward it
         return true;
     }
-    if (it.value() == state) {
+    const bool pressed = state == Keyboard::State::Pressed;
+    // the first event of a key is always forwarded, e.g. the release of a key which got pressed
+    // before the compositor started or during a VT switch
+    if (keys.known.test(key) && keys.states.test(key) == pressed) {
+        return false;
+    }
+    keys.known.set(key);
+    keys.states.set(key, pressed);
+    if (pressed) {
+        keys.pressedKeys << key;
+    } else {
+        keys.pressedKeys.removeOne(key);
+    }
+    return true;
+}
+
+void SeatInterface::Private::deferPointerFrames(const QVector<PointerInterface*> &pointers)
+{
+    if (inputFrame.depth == 0) {
+        return;
+    }
+    for (PointerInterface *pointer : pointers) {
+        auto pointerPrivate = pointer->d_func();
+        if (pointerPrivate->frameDeferred) {
+            continue;
+        }
+        pointerPrivate->frameDeferred = true;
+        inputFrame.pointers << QPointer<PointerInterface>(pointer);
+    }
+}
+
+void SeatInterface::Private::Pointer::Focus::setTransformation(const QMatrix4x4 &matrix)
+{
+    transformation = matrix;
+    // only the rows and columns used for mapping a 2D point matter
+    if (matrix(3, 0) != 0.0f || matrix(3, 1) != 0.0f || matrix(3, 3) != 1.0f ||
+            matrix(0, 1) != 0.0f || matrix(1, 0) != 0.0f) {
+        transformationType = TransformationType::General;
+    } else if (matrix(0, 0) != 1.0f || matrix(1, 1) != 1.0f) {
+        transformationType = TransformationType::Scale;
+    } else if (matrix(0, 3) != 0.0f || matrix(1, 3) != 0.0f) {
+        transformationType = TransformationType::Translation;
+    } else {
+        transformationType = TransformationType::Identity;
+    }
+    translation = QPointF(matrix(0, 3), matrix(1, 3));
+    xScale = matrix(0, 0);
+    yScale = matrix(1, 1);
+}
+
+QPointF SeatInterface::Private::Pointer::Focus::mapToSurface(const QPointF &globalPosition) const
+{
+    switch (transformationType) {
+    case TransformationType::Identity:
+        return globalPosition;
+    case TransformationType::Translation:
+        return globalPosition + translation;
+    case TransformationType::Scale:
+        return QPointF(globalPosition.x() * xScale, globalPosition.y() * yScale) + translation;
+    case TransformationType::General:
+    default:
+        return transformation.map(globalPosition);
+    }
+}
+
+void SeatInterface::Private::sendPointerMotion()
+{
+    inputFrame.pointerMotion = false;
+    if (globalPointer.focus.pointers.isEmpty()) {
+        return;
+    }
+    // the same position for all pointers of the focused client
+    const QPointF pos = globalPointer.focus.mapToSurface(globalPointer.pos);
+    for (auto it = globalPointer.focus.pointers.constBegin(), end = globalPointer.focus.pointers.constEnd(); it != end; ++it) {
+        (*it)->d_func()->updatePosition(pos);
+    }
+    inputEventsSent++;
+}
+
+void SeatInterface::Private::invalidatePointerTargets()
+{
+    globalPointer.focus.targetsValid = false;
+}
+
+void SeatInterface::Private::updatePointerTargets()
+{
+    auto &focus = globalPointer.focus;
+    if (focus.targetsValid) {
+        return;
+    }
+    focus.relativePointers.clear();
+    focus.swipeGestures.clear();
+    focus.pinchGestures.clear();
+    for (auto it = focus.pointers.constBegin(), end = focus.pointers.constEnd(); it != end; ++it) {
+        const auto pointerPrivate = (*it)->d_func();
+        for (auto relativePointer : qAsConst(pointerPrivate->relativePointers)) {
+            focus.relativePointers << Pointer::Focus::RelativePointer{*it, relativePointer};
+        }
+        focus.swipeGestures << pointerPrivate->swipeGestures;
+        focus.pinchGestures << pointerPrivate->pinchGestures;
+    }
+    focus.targetsValid = true;
+}
+
+bool SeatInterface::Private::isGestureOnPointerFocus()
+{
+    if (globalPointer.gestureSurface.data() != globalPointer.focus.surface) {
+        return false;
+    }
+    updatePointerTargets();
+    return true;
+}
+
+void SeatInterface::Private::sendRelativePointerMotion(const QSizeF &delta, const QSizeF &deltaNonAccelerated, quint64 microseconds)
+{
+    updatePointerTargets();
+    const auto &relativePointers = globalPointer.focus.relativePointers;
+    if (relativePointers.isEmpty()) {
+        return;
+    }
+    // the relative pointers are grouped by their pointer, which gets one frame after its relative pointers
+    PointerInterface *pointer = nullptr;
+    for (auto it = relativePointers.constBegin(), end = relativePointers.constEnd(); it != end; ++it) {
+        if (pointer && pointer != it->pointer) {
+            pointer->d_func()->sendFrame();
+        }
+        it->relativePointer->relativeMotion(delta, deltaNonAccelerated, microseconds);
+        pointer = it->pointer;
+    }
+    pointer->d_func()->sendFrame();
+    inputEventsSent++;
+}
+
+void SeatInterface::Private::sendPointerAxis(Qt::Orientation orientation, quint32 delta)
+{
+    if (globalPointer.focus.pointers.isEmpty()) {
+        return;
+    }
+    for (auto it = globalPointer.focus.pointers.constBegin(), end = globalPointer.focus.pointers.constEnd(); it != end; ++it) {
+        (*it)->axis(orientation, delta);
+    }
+    inputEventsSent++;
+}
+
+void SeatInterface::Private::flushPointerEvents()
+{
+    if (inputFrame.pointerMotion) {
+        sendPointerMotion();
+    }
+    if (inputFrame.relativeMotion) {
+        inputFrame.relativeMotion = false;
+        sendRelativePointerMotion(inputFrame.relativeDelta, inputFrame.relativeDeltaNonAccelerated, inputFrame.relativeMicroseconds);
+        inputFrame.relativeDelta = QSizeF();
+        inputFrame.relativeDeltaNonAccelerated = QSizeF();
+    }
+    if (inputFrame.verticalAxis) {
+        inputFrame.verticalAxis = false;
+        sendPointerAxis(Qt::Vertical, inputFrame.verticalAxisDelta);
+        inputFrame.verticalAxisDelta = 0;
+    }
+    if (inputFrame.horizontalAxis) {
+        inputFrame.horizontalAxis = false;
+        sendPointerAxis(Qt::Horizontal, inputFrame.horizontalAxisDelta);
+        inputFrame.horizontalAxisDelta = 0;
+    }
+}
+
+bool SeatInterface::Private::isBacklogged(SurfaceInterface *surface) const
+{
+    return surface && surface->client() && surface->client()->unreadBytes() > s_backlogThreshold;
+}
+
+void SeatInterface::Private::addInputQueueSource()
+{
+    if (inputQueue.source || inputQueue.fd == -1) {
+        return;
+    }
+    inputQueue.source = wl_event_loop_add_fd(wl_display_get_event_loop(*display), inputQueue.fd, WL_EVENT_READABLE, inputQueueCallback, this);
+    // events might have been queued before the Display was running
+    dispatchInputQueue();
+}
+
+void SeatInterface::Private::removeInputQueueSource()
+{
+    if (!inputQueue.source) {
+        return;
+    }
+    wl_event_source_remove(inputQueue.source);
+    inputQueue.source = nullptr;
+}
+
+int SeatInterface::Private::inputQueueCallback(int fd, uint32_t mask, void *data)
+{
+    Q_UNUSED(mask)
+    eventfd_t count;
+    eventfd_read(fd, &count);
+    reinterpret_cast<Private*>(data)->dispatchInputQueue();
+    return 0;
+}
+
+bool SeatInterface::Private::queueInputEvent(const QueuedInputEvent &event)
+{
+    const quint32 head = inputQueue.head.load(std::memory_order_relaxed);
+    if (head - inputQueue.tail.load(std::memory_order_acquire) == s_inputQueueSize) {
         return false;
     }
-    it.value() = state;
+    inputQueue.events[head % s_inputQueueSize] = event;
+    inputQueue.head.store(head + 1);
+    // only wake up the Display thread once per drain
+    if (!inputQueue.wakeupPending.exchange(true)) {
+        eventfd_write(inputQueue.fd, 1);
+    }
     return true;
 }
 
+void SeatInterface::Private::dispatchInputQueue()
+{
+    // reset before reading the head, events pushed afterwards signal the eventfd again
+    inputQueue.wakeupPending.store(false);
+    quint32 head = inputQueue.head.load();
+    quint32 tail = inputQueue.tail.load(std::memory_order_relaxed);
+    const bool framed = inputQueue.framed.load();
+    if (framed && head - tail < s_inputQueueSize) {
+        // only process complete frames, the rest of a frame signals the eventfd again.
+        // A full queue gets drained completely, the producer could not end the frame otherwise
+        while (head != tail && inputQueue.events[(head - 1) % s_inputQueueSize].type != QueuedInputEvent::Type::Frame) {
+            --head;
+        }
+    }
+    bool inFrame = false;
+    bool touchEvents = false;
+    auto endFrame = [this, &inFrame, &touchEvents] {
+        if (touchEvents) {
+            q->touchFrame();
+        }
+        q->endInputFrame();
+        inFrame = false;
+        touchEvents = false;
+    };
+    for (; tail != head; ++tail) {
+        const QueuedInputEvent event = inputQueue.events[tail % s_inputQueueSize];
+        // hand the slot back to the producer before processing the event
+        inputQueue.tail.store(tail + 1, std::memory_order_release);
+        if (event.type == QueuedInputEvent::Type::Frame) {
+            if (inFrame) {
+                endFrame();
+            }
+            continue;
+        }
+        if (!inFrame) {
+            q->beginInputFrame();
+            inFrame = true;
+        }
+        q->setTimestamp(event.time);
+        switch (event.type) {
+        case QueuedInputEvent::Type::PointerMotion:
+            q->setPointerPos(event.position);
+            break;
+        case QueuedInputEvent::Type::PointerButtonPress:
+            q->pointerButtonPressed(event.code);
+            break;
+        case QueuedInputEvent::Type::PointerButtonRelease:
+            q->pointerButtonReleased(event.code);
+            break;
+        case QueuedInputEvent::Type::PointerAxis:
+            q->pointerAxis(Qt::Orientation(event.code), event.value);
+            break;
+        case QueuedInputEvent::Type::KeyPress:
+            q->keyPressed(event.code);
+            break;
+        case QueuedInputEvent::Type::KeyRelease:
+            q->keyReleased(event.code);
+            break;
+        case QueuedInputEvent::Type::TouchDown: {
+            qint32 &id = inputQueue.touchIds[event.code];
+            if (id == -1) {
+                id = q->touchDown(event.position);
+                touchEvents = true;
+            }
+            break;
+        }
+        case QueuedInputEvent::Type::TouchMotion: {
+            const qint32 id = inputQueue.touchIds[event.code];
+            if (id != -1) {
+                q->touchMove(id, event.position);
+                touchEvents = true;
+            }
+            break;
+        }
+        case QueuedInputEvent::Type::TouchUp: {
+            qint32 &id = inputQueue.touchIds[event.code];
+            if (id != -1) {
+                q->touchUp(id);
+                id = -1;
+                touchEvents = true;
+            }
+            break;
+        }
+        case QueuedInputEvent::Type::Frame:
+            Q_UNREACHABLE();
+        }
+        if (!framed) {
+            // the frames of the producer are not known, keep each event on its own
+            endFrame();
+        }
+    }
+    if (inFrame) {
+        endFrame();
+    }
+}
+
+void SeatInterface::Private::flushBackloggedMotion()
+{
+    if (inputFrame.depth > 0) {
+        // sent at the end of the input frame
+        return;
+    }
+    bool backlogged = false;
+    if (inputFrame.pointerMotion || inputFrame.relativeMotion) {
+        if (isBacklogged(globalPointer.focus.surface)) {
+            backlogged = true;
+        } else {
+            flushPointerEvents();
+        }
+    }
+    if (inputFrame.touchMotion != 0) {
+        if (isBacklogged(globalTouch.focus.surface)) {
+            backlogged = true;
+        } else {
+            flushTouchMotion();
+            // including the frames held back with the motion
+            inputFrame.touchFrame = false;
+            sendTouchFrame();
+        }
+    }
+    if (!backlogged) {
+        return;
+    }
+    if (!backlogTimer) {
+        backlogTimer = new QTimer(q);
+        backlogTimer->setSingleShot(true);
+        backlogTimer->setInterval(s_backlogRetryInterval);
+        QObject::connect(backlogTimer, &QTimer::timeout, q, [this] { flushBackloggedMotion(); });
+    }
+    if (!backlogTimer->isActive()) {
+        backlogTimer->start();
+    }
+}
+
 void SeatInterface::Private::sendName(wl_resource *r)
 {
     if (wl_resource_get_version(r) < WL_SEAT_NAME_SINCE_VERSION) {
@@ -186,48 +668,75 @@ SeatInterface::Private *SeatInterface::Private::cast(wl_resource *r)
 namespace {
 template <typename T>
 static
-T *interfaceForSurface(SurfaceInterface *surface, const QVector<T*> &interfaces)
+void addClientInterface(ClientConnection *client, T *interface, QHash<ClientConnection*, QVector<T*>> &interfaces)
+{
+    interfaces[client] << interface;
+}
+
+template <typename T>
+static
+void removeClientInterface(ClientConnection *client, T *interface, QHash<ClientConnection*, QVector<T*>> &interfaces)
+{
+    auto it = interfaces.find(client);
+    if (it == interfaces.end()) {
+        return;
+    }
+    it->removeOne(interface);
+    if (it->isEmpty()) {
+        interfaces.erase(it);
+    }
+}
+
+template <typename T>
+static
+T *interfaceForSurface(SurfaceInterface *surface, const QHash<ClientConnection*, QVector<T*>> &interfaces)
 {
     if (!surface) {
         return nullptr;
     }
-
-    for (auto it = interfaces.begin(); it != interfaces.end(); ++it) {
-        if ((*it)->client() == surface->client()) {
-            return (*it);
-        }
+    auto it = interfaces.constFind(surface->client());
+    if (it == interfaces.constEnd()) {
+        return nullptr;
     }
-    return nullptr;
+    return it->first();
 }
 
 template <typename T>
 static
-QVector<T *> interfacesForSurface(SurfaceInterface *surface, const QVector<T*> &interfaces)
+QVector<T *> interfacesForSurface(SurfaceInterface *surface, const QHash<ClientConnection*, QVector<T*>> &interfaces)
 {
     QVector<T *> ret;
     if (!surface) {
         return ret;
     }
-
-    for (auto it = interfaces.begin(); it != interfaces.end(); ++it) {
-        if ((*it)->client() == surface->client() && (*it)->resource()) {
-            ret << *it;
+    auto it = interfaces.constFind(surface->client());
+    if (it == interfaces.constEnd()) {
+        return ret;
+    }
+    ret.reserve(it->count());
+    for (T *interface : *it) {
+        if (interface->resource()) {
+            ret << interface;
         }
     }
     return ret;
 }
 
-template <typename T>
-static
-bool forEachInterface(SurfaceInterface *surface, const QVector<T*> &interfaces, std::function<void (T*)> method)
+template <typename T, typename Visitor>
+static inline
+bool forEachInterface(SurfaceInterface *surface, const QHash<ClientConnection*, QVector<T*>> &interfaces, Visitor method)
 {
     if (!surface) {
         return false;
     }
+    auto it = interfaces.constFind(surface->client());
+    if (it == interfaces.constEnd()) {
+        return false;
+    }
     bool calledAtLeastOne = false;
-    for (auto it = interfaces.begin(); it != interfaces.end(); ++it) {
-        if ((*it)->client() == surface->client() && (*it)->resource()) {
-            method(*it);
+    for (T *interface : *it) {
+        if (interface->resource()) {
+            method(interface);
             calledAtLeastOne = true;
         }
     }
@@ -238,35 +747,38 @@ bool forEachInterface(SurfaceInterface *surface, const QVector<T*> &interfaces,
 
 QVector<PointerInterface *> SeatInterface::Private::pointersForSurface(SurfaceInterface *surface) const
 {
-    return interfacesForSurface(surface, pointers);
+    return interfacesForSurface(surface, clientPointers);
 }
 
 QVector<KeyboardInterface *> SeatInterface::Private::keyboardsForSurface(SurfaceInterface *surface) const
 {
-    return interfacesForSurface(surface, keyboards);
+    return interfacesForSurface(surface, clientKeyboards);
 }
 
 QVector<TouchInterface *> SeatInterface::Private::touchsForSurface(SurfaceInterface *surface) const
 {
-    return interfacesForSurface(surface, touchs);
+    return interfacesForSurface(surface, clientTouchs);
 }
 
 DataDeviceInterface *SeatInterface::Private::dataDeviceForSurface(SurfaceInterface *surface) const
 {
-    return interfaceForSurface(surface, dataDevices);
+    return interfaceForSurface(surface, clientDataDevices);
 }
 
 TextInputInterface *SeatInterface::Private::textInputForSurface(SurfaceInterface *surface) const
 {
-    return interfaceForSurface(surface, textInputs);
+    return interfaceForSurface(surface, clientTextInputs);
 }
 
 void SeatInterface::Private::registerDataDevice(DataDeviceInterface *dataDevice)
 {
     Q_ASSERT(dataDevice->seat() == q);
+    ClientConnection *client = dataDevice->client();
     dataDevices << dataDevice;
-    auto dataDeviceCleanup = [this, dataDevice] {
+    addClientInterface(client, dataDevice, clientDataDevices);
+    auto dataDeviceCleanup = [this, dataDevice, client] {
         dataDevices.removeOne(dataDevice);
+        removeClientInterface(client, dataDevice, clientDataDevices);
         if (keys.focus.selection == dataDevice) {
             keys.focus.selection = nullptr;
         }
@@ -297,11 +809,11 @@ void SeatInterface::Private::registerDataDevice(DataDeviceInterface *dataDevice)
             auto *dragSurface = dataDevice->origin();
             if (q->hasImplicitPointerGrab(dragSerial)) {
                 drag.mode = Drag::Mode::Pointer;
-                drag.sourcePointer = interfaceForSurface(dragSurface, pointers);
+                drag.sourcePointer = interfaceForSurface(dragSurface, clientPointers);
                 drag.transformation = globalPointer.focus.transformation;
             } else if (q->hasImplicitTouchGrab(dragSerial)) {
                 drag.mode = Drag::Mode::Touch;
-                drag.sourceTouch = interfaceForSurface(dragSurface, touchs);
+                drag.sourceTouch = interfaceForSurface(dragSurface, clientTouchs);
                 // TODO: touch transformation
             } else {
                 // no implicit grab, abort drag
@@ -317,7 +829,7 @@ void SeatInterface::Private::registerDataDevice(DataDeviceInterface *dataDevice)
                 drag.transformation = globalPointer.focus.transformation;
             }
             drag.source = dataDevice;
-            drag.sourcePointer = interfaceForSurface(originSurface, pointers);
+            drag.sourcePointer = interfaceForSurface(originSurface, clientPointers);
             drag.destroyConnection = QObject::connect(dataDevice, &QObject::destroyed, q,
                 [this] {
                     endDrag(display->nextSerial());
@@ -361,7 +873,9 @@ void SeatInterface::Private::registerTextInput(TextInputInterface *ti)
     if (textInputs.contains(ti)) {
         return;
     }
+    ClientConnection *client = ti->client();
     textInputs << ti;
+    addClientInterface(client, ti, clientTextInputs);
     if (textInput.focus.surface && textInput.focus.surface->client() == ti->client()) {
         // this is a text input for the currently focused text input surface
         if (!textInput.focus.textInput) {
@@ -371,8 +885,9 @@ void SeatInterface::Private::registerTextInput(TextInputInterface *ti)
         }
     }
     QObject::connect(ti, &QObject::destroyed, q,
-        [this, ti] {
+        [this, ti, client] {
             textInputs.removeAt(textInputs.indexOf(ti));
+            removeClientInterface(client, ti, clientTextInputs);
             if (textInput.focus.textInput == ti) {
                 textInput.focus.textInput = nullptr;
                 emit q->focusedTextInputChanged();
@@ -495,9 +1010,12 @@ void SeatInterface::Private::getPointer(wl_client *client, wl_resource *resource
         return;
     }
     pointers << pointer;
+    addClientInterface(clientConnection, pointer, clientPointers);
     if (globalPointer.focus.surface && globalPointer.focus.surface->client() == clientConnection) {
         // this is a pointer for the currently focused pointer surface
         globalPointer.focus.pointers << pointer;
+        invalidatePointerTargets();
+        deferPointerFrames({pointer});
         pointer->setFocusedSurface(globalPointer.focus.surface, globalPointer.focus.serial);
         pointer->d_func()->sendFrame();
         if (globalPointer.focus.pointers.count() == 1) {
@@ -506,9 +1024,11 @@ void SeatInterface::Private::getPointer(wl_client *client, wl_resource *resource
         }
     }
     QObject::connect(pointer, &QObject::destroyed, q,
-        [pointer,this] {
+        [pointer, clientConnection, this] {
             pointers.removeAt(pointers.indexOf(pointer));
+            removeClientInterface(clientConnection, pointer, clientPointers);
             if (globalPointer.focus.pointers.removeOne(pointer)) {
+                invalidatePointerTargets();
                 if (globalPointer.focus.pointers.isEmpty()) {
                     emit q->focusedPointerChanged(nullptr);
                 }
@@ -536,17 +1056,19 @@ void SeatInterface::Private::getKeyboard(wl_client *client, wl_resource *resourc
     }
     keyboard->repeatInfo(keys.keyRepeat.charactersPerSecond, keys.keyRepeat.delay);
     if (keys.keymap.xkbcommonCompatible) {
-        keyboard->setKeymap(keys.keymap.fd, keys.keymap.size);
+        sendKeymap(keyboard);
     }
     keyboards << keyboard;
+    addClientInterface(clientConnection, keyboard, clientKeyboards);
     if (keys.focus.surface && keys.focus.surface->client() == clientConnection) {
         // this is a keyboard for the currently focused keyboard surface
         keys.focus.keyboards << keyboard;
         keyboard->setFocusedSurface(keys.focus.surface, keys.focus.serial);
     }
     QObject::connect(keyboard, &QObject::destroyed, q,
-        [keyboard,this] {
+        [keyboard, clientConnection, this] {
             keyboards.removeAt(keyboards.indexOf(keyboard));
+            removeClientInterface(clientConnection, keyboard, clientKeyboards);
             keys.focus.keyboards.removeOne(keyboard);
         }
     );
@@ -570,16 +1092,18 @@ void SeatInterface::Private::getTouch(wl_client *client, wl_resource *resource,
         return;
     }
     touchs << touch;
+    addClientInterface(clientConnection, touch, clientTouchs);
     if (globalTouch.focus.surface && globalTouch.focus.surface->client() == clientConnection) {
         // this is a touch for the currently focused touch surface
         globalTouch.focus.touchs << touch;
-        if (!globalTouch.ids.isEmpty()) {
+        if (globalTouch.ids != 0) {
             // TODO: send out all the points
         }
     }
     QObject::connect(touch, &QObject::destroyed, q,
-        [touch,this] {
+        [touch, clientConnection, this] {
             touchs.removeAt(touchs.indexOf(touch));
+            removeClientInterface(clientConnection, touch, clientTouchs);
             globalTouch.focus.touchs.removeOne(touch);
         }
     );
@@ -633,6 +1157,17 @@ void SeatInterface::setPointerPos(const QPointF &pos)
         return;
     }
     d->globalPointer.pos = pos;
+    d->inputEventsReceived++;
+    if (d->inputFrame.depth > 0) {
+        d->inputFrame.pointerMotion = true;
+    } else if (d->isBacklogged(d->globalPointer.focus.surface)) {
+        // the client falls behind, it only gets the latest position once it caught up
+        // or before the next button, axis or focus change
+        d->inputFrame.pointerMotion = true;
+        d->flushBackloggedMotion();
+    } else {
+        d->sendPointerMotion();
+    }
     emit pointerPosChanged(pos);
 }
 
@@ -668,7 +1203,7 @@ void SeatInterface::setDragTarget(SurfaceInterface *surface, const QPointF &glob
         setPointerPos(globalPosition);
     } else if (d->drag.mode == Private::Drag::Mode::Touch &&
                d->globalTouch.focus.firstTouchPos != globalPosition) {
-        touchMove(d->globalTouch.ids.first(), globalPosition);
+        touchMove(d->globalTouch.firstId(), globalPosition);
     }
     if (d->drag.target) {
         d->drag.surface = surface;
@@ -717,6 +1252,8 @@ void SeatInterface::setFocusedPointerSurface(SurfaceInterface *surface, const QM
         // ignore
         return;
     }
+    // pending motion belongs to the previous focus
+    d->flushPointerEvents();
     const quint32 serial = d->display->nextSerial();
     QSet<PointerInterface *> framePointers;
     for (auto it = d->globalPointer.focus.pointers.constBegin(), end = d->globalPointer.focus.pointers.constEnd(); it != end; ++it) {
@@ -730,6 +1267,7 @@ void SeatInterface::setFocusedPointerSurface(SurfaceInterface *surface, const QM
     d->globalPointer.focus.surface = surface;
     auto p = d->pointersForSurface(surface);
     d->globalPointer.focus.pointers = p;
+    d->deferPointerFrames(p);
     if (d->globalPointer.focus.surface) {
         d->globalPointer.focus.destroyConnection = connect(surface, &QObject::destroyed, this,
             [this] {
@@ -739,7 +1277,7 @@ void SeatInterface::setFocusedPointerSurface(SurfaceInterface *surface, const QM
             }
         );
         d->globalPointer.focus.offset = QPointF();
-        d->globalPointer.focus.transformation = transformation;
+        d->globalPointer.focus.setTransformation(transformation);
         d->globalPointer.focus.serial = serial;
     }
     if (p.isEmpty()) {
@@ -776,8 +1314,9 @@ void SeatInterface::setFocusedPointerSurfacePosition(const QPointF &surfacePosit
     Q_D();
     if (d->globalPointer.focus.surface) {
         d->globalPointer.focus.offset = surfacePosition;
-        d->globalPointer.focus.transformation = QMatrix4x4();
-        d->globalPointer.focus.transformation.translate(-surfacePosition.x(), -surfacePosition.y());
+        QMatrix4x4 transformation;
+        transformation.translate(-surfacePosition.x(), -surfacePosition.y());
+        d->globalPointer.focus.setTransformation(transformation);
     }
 }
 
@@ -791,7 +1330,7 @@ void SeatInterface::setFocusedPointerSurfaceTransformation(const QMatrix4x4 &tra
 {
     Q_D();
     if (d->globalPointer.focus.surface) {
-        d->globalPointer.focus.transformation = transformation;
+        d->globalPointer.focus.setTransformation(transformation);
     }
 }
 
@@ -839,25 +1378,37 @@ bool SeatInterface::isPointerButtonPressed(Qt::MouseButton button) const
 bool SeatInterface::isPointerButtonPressed(quint32 button) const
 {
     Q_D();
-    auto it = d->globalPointer.buttonStates.constFind(button);
-    if (it == d->globalPointer.buttonStates.constEnd()) {
+    if (button >= Private::s_keyCount) {
         return false;
     }
-    return it.value() == Private::Pointer::State::Pressed ? true : false;
+    return d->globalPointer.buttonStates.test(button);
 }
 
 void SeatInterface::pointerAxis(Qt::Orientation orientation, quint32 delta)
 {
     Q_D();
+    d->inputEventsReceived++;
     if (d->drag.mode == Private::Drag::Mode::Pointer) {
         // ignore
         return;
     }
-    if (d->globalPointer.focus.surface) {
-        for (auto it = d->globalPointer.focus.pointers.constBegin(), end = d->globalPointer.focus.pointers.constEnd(); it != end; ++it) {
-            (*it)->axis(orientation, delta);
+    if (!d->globalPointer.focus.surface) {
+        return;
+    }
+    if (d->inputFrame.depth > 0) {
+        // accumulate the deltas till the end of the input frame
+        if (orientation == Qt::Vertical) {
+            d->inputFrame.verticalAxis = true;
+            d->inputFrame.verticalAxisDelta += delta;
+        } else {
+            d->inputFrame.horizontalAxis = true;
+            d->inputFrame.horizontalAxisDelta += delta;
         }
+        return;
     }
+    // motion held back from a backlogged client goes first
+    d->flushPointerEvents();
+    d->sendPointerAxis(orientation, delta);
 }
 
 void SeatInterface::pointerButtonPressed(Qt::MouseButton button)
@@ -872,6 +1423,7 @@ void SeatInterface::pointerButtonPressed(Qt::MouseButton button)
 void SeatInterface::pointerButtonPressed(quint32 button)
 {
     Q_D();
+    d->inputEventsReceived++;
     const quint32 serial = d->display->nextSerial();
     d->updatePointerButtonSerial(button, serial);
     d->updatePointerButtonState(button, Private::Pointer::State::Pressed);
@@ -880,9 +1432,14 @@ void SeatInterface::pointerButtonPressed(quint32 button)
         return;
     }
     if (auto *focusSurface = d->globalPointer.focus.surface) {
+        // the button is pressed at the latest position
+        d->flushPointerEvents();
         for (auto it = d->globalPointer.focus.pointers.constBegin(), end = d->globalPointer.focus.pointers.constEnd(); it != end; ++it) {
             (*it)->buttonPressed(button, serial);
         }
+        if (!d->globalPointer.focus.pointers.isEmpty()) {
+            d->inputEventsSent++;
+        }
         if (focusSurface == d->keys.focus.surface) {
             // update the focused child surface
             auto p = focusedPointer();
@@ -907,6 +1464,7 @@ void SeatInterface::pointerButtonReleased(Qt::MouseButton button)
 void SeatInterface::pointerButtonReleased(quint32 button)
 {
     Q_D();
+    d->inputEventsReceived++;
     const quint32 serial = d->display->nextSerial();
     const quint32 currentButtonSerial = pointerButtonSerial(button);
     d->updatePointerButtonSerial(button, serial);
@@ -920,9 +1478,14 @@ void SeatInterface::pointerButtonReleased(quint32 button)
         return;
     }
     if (d->globalPointer.focus.surface) {
+        // the button is released at the latest position
+        d->flushPointerEvents();
         for (auto it = d->globalPointer.focus.pointers.constBegin(), end = d->globalPointer.focus.pointers.constEnd(); it != end; ++it) {
             (*it)->buttonReleased(button, serial);
         }
+        if (!d->globalPointer.focus.pointers.isEmpty()) {
+            d->inputEventsSent++;
+        }
     }
 }
 
@@ -934,21 +1497,29 @@ quint32 SeatInterface::pointerButtonSerial(Qt::MouseButton button) const
 quint32 SeatInterface::pointerButtonSerial(quint32 button) const
 {
     Q_D();
-    auto it = d->globalPointer.buttonSerials.constFind(button);
-    if (it == d->globalPointer.buttonSerials.constEnd()) {
+    if (button >= Private::s_keyCount) {
         return 0;
     }
-    return it.value();
+    return d->globalPointer.buttonSerials[button];
 }
 
 void SeatInterface::relativePointerMotion(const QSizeF &delta, const QSizeF &deltaNonAccelerated, quint64 microseconds)
 {
     Q_D();
-    if (d->globalPointer.focus.surface) {
-        for (auto it = d->globalPointer.focus.pointers.constBegin(), end = d->globalPointer.focus.pointers.constEnd(); it != end; ++it) {
-            (*it)->relativeMotion(delta, deltaNonAccelerated, microseconds);
-        }
+    if (!d->globalPointer.focus.surface) {
+        return;
     }
+    d->inputEventsReceived++;
+    if (d->inputFrame.relativeMotion || d->isBacklogged(d->globalPointer.focus.surface)) {
+        // the client falls behind, accumulate the deltas till it caught up
+        d->inputFrame.relativeMotion = true;
+        d->inputFrame.relativeDelta += delta;
+        d->inputFrame.relativeDeltaNonAccelerated += deltaNonAccelerated;
+        d->inputFrame.relativeMicroseconds = microseconds;
+        d->flushBackloggedMotion();
+        return;
+    }
+    d->sendRelativePointerMotion(delta, deltaNonAccelerated, microseconds);
 }
 
 void SeatInterface::startPointerSwipeGesture(quint32 fingerCount)
@@ -962,11 +1533,17 @@ void SeatInterface::startPointerSwipeGesture(quint32 fingerCount)
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial, fingerCount] (PointerInterface *p) {
-            p->d_func()->startSwipeGesture(serial, fingerCount);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.swipeGestures)) {
+            gesture->start(serial, fingerCount);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial, fingerCount] (PointerInterface *p) {
+                p->d_func()->startSwipeGesture(serial, fingerCount);
+            }
+        );
+    }
 }
 
 void SeatInterface::updatePointerSwipeGesture(const QSizeF &delta)
@@ -975,11 +1552,17 @@ void SeatInterface::updatePointerSwipeGesture(const QSizeF &delta)
     if (d->globalPointer.gestureSurface.isNull()) {
         return;
     }
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [delta] (PointerInterface *p) {
-            p->d_func()->updateSwipeGesture(delta);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.swipeGestures)) {
+            gesture->update(delta);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [delta] (PointerInterface *p) {
+                p->d_func()->updateSwipeGesture(delta);
+            }
+        );
+    }
 }
 
 void SeatInterface::endPointerSwipeGesture()
@@ -989,11 +1572,17 @@ void SeatInterface::endPointerSwipeGesture()
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial] (PointerInterface *p) {
-            p->d_func()->endSwipeGesture(serial);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.swipeGestures)) {
+            gesture->end(serial);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial] (PointerInterface *p) {
+                p->d_func()->endSwipeGesture(serial);
+            }
+        );
+    }
     d->globalPointer.gestureSurface.clear();
 }
 
@@ -1004,11 +1593,17 @@ void SeatInterface::cancelPointerSwipeGesture()
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial] (PointerInterface *p) {
-            p->d_func()->cancelSwipeGesture(serial);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.swipeGestures)) {
+            gesture->cancel(serial);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial] (PointerInterface *p) {
+                p->d_func()->cancelSwipeGesture(serial);
+            }
+        );
+    }
     d->globalPointer.gestureSurface.clear();
 }
 
@@ -1023,11 +1618,17 @@ void SeatInterface::startPointerPinchGesture(quint32 fingerCount)
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial, fingerCount] (PointerInterface *p) {
-            p->d_func()->startPinchGesture(serial, fingerCount);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.pinchGestures)) {
+            gesture->start(serial, fingerCount);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial, fingerCount] (PointerInterface *p) {
+                p->d_func()->startPinchGesture(serial, fingerCount);
+            }
+        );
+    }
 }
 
 void SeatInterface::updatePointerPinchGesture(const QSizeF &delta, qreal scale, qreal rotation)
@@ -1036,11 +1637,17 @@ void SeatInterface::updatePointerPinchGesture(const QSizeF &delta, qreal scale,
     if (d->globalPointer.gestureSurface.isNull()) {
         return;
     }
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [delta, scale, rotation] (PointerInterface *p) {
-            p->d_func()->updatePinchGesture(delta, scale, rotation);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.pinchGestures)) {
+            gesture->update(delta, scale, rotation);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [delta, scale, rotation] (PointerInterface *p) {
+                p->d_func()->updatePinchGesture(delta, scale, rotation);
+            }
+        );
+    }
 }
 
 void SeatInterface::endPointerPinchGesture()
@@ -1050,11 +1657,17 @@ void SeatInterface::endPointerPinchGesture()
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial] (PointerInterface *p) {
-            p->d_func()->endPinchGesture(serial);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.pinchGestures)) {
+            gesture->end(serial);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial] (PointerInterface *p) {
+                p->d_func()->endPinchGesture(serial);
+            }
+        );
+    }
     d->globalPointer.gestureSurface.clear();
 }
 
@@ -1065,11 +1678,17 @@ void SeatInterface::cancelPointerPinchGesture()
         return;
     }
     const quint32 serial = d->display->nextSerial();
-    forEachInterface<PointerInterface>(d->globalPointer.gestureSurface.data(), d->pointers,
-        [serial] (PointerInterface *p) {
-            p->d_func()->cancelPinchGesture(serial);
+    if (d->isGestureOnPointerFocus()) {
+        for (auto gesture : qAsConst(d->globalPointer.focus.pinchGestures)) {
+            gesture->cancel(serial);
         }
-    );
+    } else {
+        forEachInterface(d->globalPointer.gestureSurface.data(), d->clientPointers,
+            [serial] (PointerInterface *p) {
+                p->d_func()->cancelPinchGesture(serial);
+            }
+        );
+    }
     d->globalPointer.gestureSurface.clear();
 }
 
@@ -1153,11 +1772,32 @@ void SeatInterface::setKeymap(int fd, quint32 size)
     d->keys.keymap.xkbcommonCompatible = true;
     d->keys.keymap.fd = fd;
     d->keys.keymap.size = size;
+    d->keys.keymap.shared = false;
     for (auto it = d->keyboards.constBegin(); it != d->keyboards.constEnd(); ++it) {
         (*it)->setKeymap(fd, size);
     }
 }
 
+void SeatInterface::setKeymap(const QByteArray &content)
+{
+    Q_D();
+    const auto file = d->keymapFile(content);
+    if (file.fd == -1) {
+        return;
+    }
+    if (d->keys.keymap.shared && d->keys.keymap.fd == file.fd) {
+        // unchanged
+        return;
+    }
+    d->keys.keymap.xkbcommonCompatible = true;
+    d->keys.keymap.fd = file.fd;
+    d->keys.keymap.size = file.size;
+    d->keys.keymap.shared = true;
+    for (auto it = d->keyboards.constBegin(); it != d->keyboards.constEnd(); ++it) {
+        d->sendKeymap(*it);
+    }
+}
+
 void SeatInterface::updateKeyboardModifiers(quint32 depressed, quint32 latched, quint32 locked, quint32 group)
 {
     Q_D();
@@ -1256,13 +1896,7 @@ quint32 SeatInterface::lastModifiersSerial() const
 QVector< quint32 > SeatInterface::pressedKeys() const
 {
     Q_D();
-    QVector<quint32> keys;
-    for (auto it = d->keys.states.begin(); it != d->keys.states.end(); ++it) {
-        if (it.value() == Private::Keyboard::State::Pressed) {
-            keys << it.key();
-        }
-    }
-    return keys;
+    return d->keys.pressedKeys;
 }
 
 KeyboardInterface *SeatInterface::focusedKeyboard() const
@@ -1290,7 +1924,10 @@ void SeatInterface::cancelTouchSequence()
         // and end the drag for the source, serial does not matter
         d->endDrag(0);
     }
-    d->globalTouch.ids.clear();
+    d->globalTouch.ids = 0;
+    d->inputFrame.touchMotion = 0;
+    d->inputFrame.touchFrame = false;
+    d->inputQueue.touchIds.fill(-1);
 }
 
 TouchInterface *SeatInterface::focusedTouch() const
@@ -1317,7 +1954,7 @@ QPointF SeatInterface::focusedTouchSurfacePosition() const
 bool SeatInterface::isTouchSequence() const
 {
     Q_D();
-    return !d->globalTouch.ids.isEmpty();
+    return d->globalTouch.ids != 0;
 }
 
 void SeatInterface::setFocusedTouchSurface(SurfaceInterface *surface, const QPointF &surfacePosition)
@@ -1360,12 +1997,28 @@ void SeatInterface::setFocusedTouchSurfacePosition(const QPointF &surfacePositio
 qint32 SeatInterface::touchDown(const QPointF &globalPosition)
 {
     Q_D();
-    const qint32 id = d->globalTouch.ids.isEmpty() ? 0 : d->globalTouch.ids.lastKey() + 1;
+    d->inputEventsReceived++;
+    // id 0 is the first touch point of a sequence, it is used for the pointer emulation and
+    // drags, so it must not be reused before the sequence ends
+    const quint64 usedIds = d->globalTouch.ids == 0 ? 0 : (d->globalTouch.ids | 1);
+    if (~usedIds == 0) {
+        qCWarning(KWAYLAND_SERVER) << "Too many touch points, ignoring touch down";
+        return -1;
+    }
+    // ids increase within a sequence like they did before touch points got slots,
+    // only once the last slot is taken the lowest free one gets reused
+    qint32 id = usedIds == 0 ? 0 : Private::s_touchSlotCount - qCountLeadingZeroBits(usedIds);
+    if (id == Private::s_touchSlotCount) {
+        id = qCountTrailingZeroBits(~usedIds);
+    }
     const qint32 serial = display()->nextSerial();
     const auto pos = globalPosition - d->globalTouch.focus.offset;
     for (auto it = d->globalTouch.focus.touchs.constBegin(), end = d->globalTouch.focus.touchs.constEnd(); it != end; ++it) {
         (*it)->down(id, serial, pos);
     }
+    if (!d->globalTouch.focus.touchs.isEmpty()) {
+        d->inputEventsSent++;
+    }
 
     if (id == 0) {
         d->globalTouch.focus.firstTouchPos = globalPosition;
@@ -1375,7 +2028,7 @@ qint32 SeatInterface::touchDown(const QPointF &globalPosition)
     if (id == 0 && d->globalTouch.focus.touchs.isEmpty()) {
         // If the client did not bind the touch interface fall back
         // to at least emulating touch through pointer events.
-        forEachInterface<PointerInterface>(focusedTouchSurface(), d->pointers,
+        forEachInterface(focusedTouchSurface(), d->clientPointers,
             [this, pos, serial] (PointerInterface *p) {
                 wl_pointer_send_enter(p->resource(), serial,
                                 focusedTouchSurface()->resource(),
@@ -1390,54 +2043,107 @@ qint32 SeatInterface::touchDown(const QPointF &globalPosition)
     }
 #endif
 
-    d->globalTouch.ids[id] = serial;
+    d->globalTouch.ids |= quint64(1) << id;
+    d->globalTouch.serials[id] = serial;
     return id;
 }
 
-void SeatInterface::touchMove(qint32 id, const QPointF &globalPosition)
+void SeatInterface::Private::sendTouchMotion(qint32 id, const QPointF &globalPosition)
 {
-    Q_D();
-    Q_ASSERT(d->globalTouch.ids.contains(id));
-    const auto pos = globalPosition - d->globalTouch.focus.offset;
-    for (auto it = d->globalTouch.focus.touchs.constBegin(), end = d->globalTouch.focus.touchs.constEnd(); it != end; ++it) {
+    const auto pos = globalPosition - globalTouch.focus.offset;
+    for (auto it = globalTouch.focus.touchs.constBegin(), end = globalTouch.focus.touchs.constEnd(); it != end; ++it) {
         (*it)->move(id, pos);
     }
-
-    if (id == 0) {
-        d->globalTouch.focus.firstTouchPos = globalPosition;
+    if (!globalTouch.focus.touchs.isEmpty()) {
+        inputEventsSent++;
     }
 
-    if (id == 0 && d->globalTouch.focus.touchs.isEmpty()) {
+    if (id == 0 && globalTouch.focus.touchs.isEmpty()) {
         // Client did not bind touch, fall back to emulating with pointer events.
-        forEachInterface<PointerInterface>(focusedTouchSurface(), d->pointers,
+        forEachInterface(globalTouch.focus.surface, clientPointers,
             [this, pos] (PointerInterface *p) {
-                wl_pointer_send_motion(p->resource(), timestamp(),
+                wl_pointer_send_motion(p->resource(), timestamp,
                                        wl_fixed_from_double(pos.x()), wl_fixed_from_double(pos.y()));
             }
         );
     }
-    emit touchMoved(id, d->globalTouch.ids[id], globalPosition);
+}
+
+void SeatInterface::Private::flushTouchMotion()
+{
+    const quint64 touchMotion = inputFrame.touchMotion;
+    inputFrame.touchMotion = 0;
+    for (quint64 pending = touchMotion; pending != 0; pending &= pending - 1) {
+        const qint32 id = qCountTrailingZeroBits(pending);
+        sendTouchMotion(id, inputFrame.touchMotionPositions[id]);
+    }
+}
+
+void SeatInterface::touchMove(qint32 id, const QPointF &globalPosition)
+{
+    Q_D();
+    if (!d->globalTouch.isActive(id)) {
+        return;
+    }
+    d->inputEventsReceived++;
+    if (d->inputFrame.depth > 0) {
+        // only the latest position is sent at the end of the input frame
+        d->inputFrame.touchMotion |= quint64(1) << id;
+        d->inputFrame.touchMotionPositions[id] = globalPosition;
+    } else if (d->isBacklogged(d->globalTouch.focus.surface)) {
+        // the client falls behind, it only gets the latest position once it caught up
+        // or before the touch point is lifted
+        d->inputFrame.touchMotion |= quint64(1) << id;
+        d->inputFrame.touchMotionPositions[id] = globalPosition;
+        d->flushBackloggedMotion();
+    } else {
+        d->sendTouchMotion(id, globalPosition);
+    }
+
+    if (id == 0) {
+        d->globalTouch.focus.firstTouchPos = globalPosition;
+    }
+    emit touchMoved(id, d->globalTouch.serials[id], globalPosition);
+}
+
+void SeatInterface::touchMove(const QVector<QPair<qint32, QPointF>> &points)
+{
+    beginInputFrame();
+    for (auto it = points.constBegin(), end = points.constEnd(); it != end; ++it) {
+        touchMove(it->first, it->second);
+    }
+    touchFrame();
+    endInputFrame();
 }
 
 void SeatInterface::touchUp(qint32 id)
 {
     Q_D();
-    Q_ASSERT(d->globalTouch.ids.contains(id));
+    if (!d->globalTouch.isActive(id)) {
+        return;
+    }
+    d->inputEventsReceived++;
+    // the touch point is lifted at the latest position, the motion of the other touch points
+    // happened before as well
+    d->flushTouchMotion();
     const qint32 serial = display()->nextSerial();
     if (d->drag.mode == Private::Drag::Mode::Touch &&
-            d->drag.source->dragImplicitGrabSerial() == d->globalTouch.ids.value(id)) {
+            d->drag.source->dragImplicitGrabSerial() == d->globalTouch.serials[id]) {
         // the implicitly grabbing touch point has been upped
         d->endDrag(serial);
     }
     for (auto it = d->globalTouch.focus.touchs.constBegin(), end = d->globalTouch.focus.touchs.constEnd(); it != end; ++it) {
         (*it)->up(id, serial);
     }
+    if (!d->globalTouch.focus.touchs.isEmpty()) {
+        d->inputEventsSent++;
+    }
 
 #if HAVE_LINUX_INPUT_H
     if (id == 0 && d->globalTouch.focus.touchs.isEmpty()) {
         // Client did not bind touch, fall back to emulating with pointer events.
         const quint32 serial = display()->nextSerial();
-        forEachInterface<PointerInterface>(focusedTouchSurface(), d->pointers,
+        forEachInterface(focusedTouchSurface(), d->clientPointers,
             [this, serial] (PointerInterface *p) {
                 wl_pointer_send_button(p->resource(), serial, timestamp(), BTN_LEFT, WL_POINTER_BUTTON_STATE_RELEASED);
             }
@@ -1445,17 +2151,172 @@ void SeatInterface::touchUp(qint32 id)
     }
 #endif
 
-    d->globalTouch.ids.remove(id);
+    d->globalTouch.ids &= ~(quint64(1) << id);
 }
 
 void SeatInterface::touchFrame()
 {
     Q_D();
-    for (auto it = d->globalTouch.focus.touchs.constBegin(), end = d->globalTouch.focus.touchs.constEnd(); it != end; ++it) {
+    if (d->inputFrame.depth > 0) {
+        d->inputFrame.touchFrame = true;
+        return;
+    }
+    if (d->inputFrame.touchMotion != 0) {
+        // the motion is held back for a backlogged client, the frame gets sent with it
+        d->inputFrame.touchFrame = true;
+        return;
+    }
+    d->inputFrame.touchFrame = false;
+    d->sendTouchFrame();
+}
+
+void SeatInterface::Private::sendTouchFrame()
+{
+    for (auto it = globalTouch.focus.touchs.constBegin(), end = globalTouch.focus.touchs.constEnd(); it != end; ++it) {
         (*it)->frame();
     }
 }
 
+void SeatInterface::beginInputFrame()
+{
+    Q_D();
+    if (d->inputFrame.depth++ > 0) {
+        return;
+    }
+    d->deferPointerFrames(d->globalPointer.focus.pointers);
+}
+
+void SeatInterface::endInputFrame()
+{
+    Q_D();
+    if (d->inputFrame.depth == 0) {
+        return;
+    }
+    if (d->inputFrame.depth > 1) {
+        d->inputFrame.depth--;
+        return;
+    }
+    d->flushPointerEvents();
+    d->flushTouchMotion();
+    if (d->inputFrame.touchFrame) {
+        d->inputFrame.touchFrame = false;
+        d->sendTouchFrame();
+    }
+    d->inputFrame.depth = 0;
+    // at most one frame event per pointer
+    const auto pointers = d->inputFrame.pointers;
+    d->inputFrame.pointers.clear();
+    for (const auto &pointer : pointers) {
+        if (pointer.isNull()) {
+            continue;
+        }
+        auto pointerPrivate = pointer->d_func();
+        pointerPrivate->frameDeferred = false;
+        if (pointerPrivate->framePending) {
+            pointerPrivate->framePending = false;
+            pointerPrivate->sendFrame();
+        }
+    }
+    for (auto it = d->globalTouch.focus.touchs.constBegin(), end = d->globalTouch.focus.touchs.constEnd(); it != end; ++it) {
+        (*it)->client()->flushUrgent();
+    }
+}
+
+bool SeatInterface::isInputFrame() const
+{
+    Q_D();
+    return d->inputFrame.depth > 0;
+}
+
+quint64 SeatInterface::inputEventsReceived() const
+{
+    Q_D();
+    return d->inputEventsReceived;
+}
+
+quint64 SeatInterface::inputEventsSent() const
+{
+    Q_D();
+    return d->inputEventsSent;
+}
+
+bool SeatInterface::queuePointerPos(const QPointF &pos, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::PointerMotion, time, 0, 0, pos});
+}
+
+bool SeatInterface::queuePointerButtonPressed(quint32 button, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::PointerButtonPress, time, button, 0, QPointF()});
+}
+
+bool SeatInterface::queuePointerButtonReleased(quint32 button, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::PointerButtonRelease, time, button, 0, QPointF()});
+}
+
+bool SeatInterface::queuePointerAxis(Qt::Orientation orientation, quint32 delta, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::PointerAxis, time, quint32(orientation), delta, QPointF()});
+}
+
+bool SeatInterface::queueKeyPressed(quint32 key, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::KeyPress, time, key, 0, QPointF()});
+}
+
+bool SeatInterface::queueKeyReleased(quint32 key, quint32 time)
+{
+    Q_D();
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::KeyRelease, time, key, 0, QPointF()});
+}
+
+bool SeatInterface::queueTouchDown(qint32 id, const QPointF &globalPosition, quint32 time)
+{
+    Q_D();
+    if (id < 0 || id >= Private::s_touchSlotCount) {
+        return false;
+    }
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::TouchDown, time, quint32(id), 0, globalPosition});
+}
+
+bool SeatInterface::queueTouchMove(qint32 id, const QPointF &globalPosition, quint32 time)
+{
+    Q_D();
+    if (id < 0 || id >= Private::s_touchSlotCount) {
+        return false;
+    }
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::TouchMotion, time, quint32(id), 0, globalPosition});
+}
+
+bool SeatInterface::queueTouchUp(qint32 id, quint32 time)
+{
+    Q_D();
+    if (id < 0 || id >= Private::s_touchSlotCount) {
+        return false;
+    }
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::TouchUp, time, quint32(id), 0, QPointF()});
+}
+
+bool SeatInterface::queueFrame()
+{
+    Q_D();
+    // set before queueing the first frame, so that the Display thread finds it
+    d->inputQueue.framed.store(true);
+    return d->queueInputEvent({Private::QueuedInputEvent::Type::Frame, 0, 0, 0, QPointF()});
+}
+
+void SeatInterface::dispatchQueuedInput()
+{
+    Q_D();
+    d->dispatchInputQueue();
+}
+
 bool SeatInterface::hasImplicitTouchGrab(quint32 serial) const
 {
     Q_D();
@@ -1463,7 +2324,12 @@ bool SeatInterface::hasImplicitTouchGrab(quint32 serial) const
         // origin surface has been destroyed
         return false;
     }
-    return d->globalTouch.ids.key(serial, -1) != -1;
+    for (quint64 pending = d->globalTouch.ids; pending != 0; pending &= pending - 1) {
+        if (d->globalTouch.serials[qCountTrailingZeroBits(pending)] == serial) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool SeatInterface::isDrag() const
@@ -1487,10 +2353,10 @@ bool SeatInterface::isDragTouch() const
 bool SeatInterface::hasImplicitPointerGrab(quint32 serial) const
 {
     Q_D();
-    const auto &serials = d->globalPointer.buttonSerials;
-    for (auto it = serials.begin(), end = serials.end(); it != end; it++) {
-        if (it.value() == serial) {
-            return isPointerButtonPressed(it.key());
+    const auto &pressedButtons = d->globalPointer.pressedButtons;
+    for (auto it = pressedButtons.constBegin(), end = pressedButtons.constEnd(); it != end; ++it) {
+        if (d->globalPointer.buttonSerials[*it] == serial) {
+            return true;
         }
     }
     return false;
@@ -205,6 +205,153 @@ public:
     void setDragTarget(SurfaceInterface *surface, const QMatrix4x4 &inputTransformation = QMatrix4x4());
     ///@}
 
+    /**
+     * @name Input frame related methods
+     **/
+    ///@{
+    /**
+     * Starts an input frame.
+     *
+     * Until the input frame ends all pointer and touch events are collected instead of being
+     * sent to the clients one by one:
+     * @li pointer motion is only sent for the last pointer position
+     * @li pointer axis deltas are accumulated per orientation
+     * @li touch motion is only sent for the last position of each touch point
+     * @li each pointer gets at most one frame event and the touch frame is sent at most once
+     *
+     * Button, enter and leave events keep their order relative to the motion, that is pending
+     * motion and axis events are sent before them. A compositor should start an input frame
+     * before processing all events read from its input devices in one event loop iteration and
+     * end it afterwards.
+     *
+     * Input frames can be nested, the events are sent when the outermost input frame ends.
+     *
+     * @see endInputFrame
+     * @see isInputFrame
+     * @since 5.58
+     **/
+    void beginInputFrame();
+    /**
+     * Ends the input frame started with beginInputFrame and sends all collected events.
+     * @see beginInputFrame
+     * @since 5.58
+     **/
+    void endInputFrame();
+    /**
+     * @returns whether an input frame is in progress.
+     * @see beginInputFrame
+     * @since 5.58
+     **/
+    bool isInputFrame() const;
+    /**
+     * @returns The number of pointer and touch events passed to this SeatInterface.
+     * @see inputEventsSent
+     * @since 5.58
+     **/
+    quint64 inputEventsReceived() const;
+    /**
+     * @returns The number of pointer and touch events sent to the focused clients.
+     * Frame events are not counted. Inside input frames this is lower than
+     * inputEventsReceived as motion and axis events get coalesced.
+     * @see inputEventsReceived
+     * @since 5.58
+     **/
+    quint64 inputEventsSent() const;
+    ///@}
+
+    /**
+     * @name Queued input related methods
+     *
+     * Unlike all other methods of SeatInterface the queue methods may be called from a thread
+     * other than the one of the Display, e.g. a dedicated thread reading the input devices.
+     * They push the event together with its timestamp into a lock-free queue which gets drained
+     * by the event loop of the Display. The drained events are processed as if the corresponding
+     * method had been called after setting the timestamp.
+     *
+     * A producer which knows the frames of its input device, e.g. from libinput, terminates each
+     * frame with queueFrame. All events of a frame are processed inside one input frame and only
+     * complete frames get processed. Without any queueFrame each event is processed in an input
+     * frame of its own.
+     *
+     * The queue supports a single producer: only one thread may push events at a time.
+     * If the queue is full the event is dropped and the queue method returns @c false.
+     *
+     * Touch points are identified by an @c id chosen by the producer in the range [0, 64).
+     * The seat maps it to the id assigned by touchDown. A touch frame is sent at the end of
+     * each input frame containing touch events.
+     **/
+    ///@{
+    /**
+     * Queues a pointer motion to the global @p pos at @p time.
+     * @see setPointerPos
+     * @since 5.58
+     **/
+    bool queuePointerPos(const QPointF &pos, quint32 time);
+    /**
+     * Queues a press of the pointer @p button at @p time.
+     * @see pointerButtonPressed
+     * @since 5.58
+     **/
+    bool queuePointerButtonPressed(quint32 button, quint32 time);
+    /**
+     * Queues a release of the pointer @p button at @p time.
+     * @see pointerButtonReleased
+     * @since 5.58
+     **/
+    bool queuePointerButtonReleased(quint32 button, quint32 time);
+    /**
+     * Queues a pointer axis event at @p time.
+     * @see pointerAxis
+     * @since 5.58
+     **/
+    bool queuePointerAxis(Qt::Orientation orientation, quint32 delta, quint32 time);
+    /**
+     * Queues a press of @p key at @p time.
+     * @see keyPressed
+     * @since 5.58
+     **/
+    bool queueKeyPressed(quint32 key, quint32 time);
+    /**
+     * Queues a release of @p key at @p time.
+     * @see keyReleased
+     * @since 5.58
+     **/
+    bool queueKeyReleased(quint32 key, quint32 time);
+    /**
+     * Queues a new touch point @p id at @p globalPosition at @p time.
+     * @see touchDown
+     * @since 5.58
+     **/
+    bool queueTouchDown(qint32 id, const QPointF &globalPosition, quint32 time);
+    /**
+     * Queues a motion of the touch point @p id to @p globalPosition at @p time.
+     * @see touchMove
+     * @since 5.58
+     **/
+    bool queueTouchMove(qint32 id, const QPointF &globalPosition, quint32 time);
+    /**
+     * Queues the end of the touch point @p id at @p time.
+     * @see touchUp
+     * @since 5.58
+     **/
+    bool queueTouchUp(qint32 id, quint32 time);
+    /**
+     * Queues the end of a frame of the input device: the events queued since the previous frame
+     * get processed in one input frame. Once a producer queued a frame, the events it queues
+     * afterwards only get processed after the next frame.
+     * @see beginInputFrame
+     * @since 5.58
+     **/
+    bool queueFrame();
+    /**
+     * Processes all queued input events right away instead of waiting for the event loop
+     * of the Display, e.g. before starting to render a frame. Must be called from the thread
+     * of the Display.
+     * @since 5.58
+     **/
+    void dispatchQueuedInput();
+    ///@}
+
     /**
      * @name Pointer related methods
      **/
@@ -519,6 +666,21 @@ public:
      **/
     ///@{
     void setKeymap(int fd, quint32 size);
+    /**
+     * Sets the xkb keymap @p content to be forwarded to all bound keyboards.
+     *
+     * The keymap is stored once in a sealed file and every client gets a read-only
+     * file descriptor for it. The files of the recently used keymaps are kept, thus
+     * switching back to a known layout does not need to write the keymap again.
+     * Unlike with setKeymap(int, quint32) the compositor does not need to keep a file
+     * around, the SeatInterface owns the file descriptor returned by keymapFileDescriptor.
+     *
+     * @param content The keymap, for example as created by xkb_keymap_get_as_string
+     * @see keymapFileDescriptor
+     * @see keymapSize
+     * @since 5.58
+     **/
+    void setKeymap(const QByteArray &content);
     void keyPressed(quint32 key);
     void keyReleased(quint32 key);
     void updateKeyboardModifiers(quint32 depressed, quint32 latched, quint32 locked, quint32 group);
@@ -583,9 +745,29 @@ public:
     TouchInterface *focusedTouch() const;
     void setFocusedTouchSurfacePosition(const QPointF &surfacePosition);
     QPointF focusedTouchSurfacePosition() const;
+    /**
+     * Starts a new touch point at @p globalPosition.
+     *
+     * Ids of lifted touch points get reused, the new touch point gets the lowest free id.
+     * At most 64 touch points can be active at the same time.
+     *
+     * @returns the id of the new touch point or @c -1 if too many touch points are active
+     **/
     qint32 touchDown(const QPointF &globalPosition);
     void touchUp(qint32 id);
     void touchMove(qint32 id, const QPointF &globalPosition);
+    /**
+     * Moves several touch points at once and sends a single touch frame afterwards.
+     *
+     * This is equivalent to calling touchMove for each of the @p points followed by
+     * touchFrame inside an input frame. Each point is a pair of the touch id and its
+     * new global position.
+     *
+     * @see touchMove
+     * @see beginInputFrame
+     * @since 5.58
+     **/
+    void touchMove(const QVector<QPair<qint32, QPointF>> &points);
     void touchFrame();
     void cancelTouchSequence();
     bool isTouchSequence() const;
@@ -720,6 +902,7 @@ Q_SIGNALS:
 private:
     friend class Display;
     friend class DataDeviceManagerInterface;
+    friend class PointerInterface;
     friend class TextInputManagerUnstableV0Interface;
     friend class TextInputManagerUnstableV2Interface;
     explicit SeatInterface(Display *display, QObject *parent);
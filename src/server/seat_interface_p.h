@@ -24,9 +24,14 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "global_p.h"
 // Qt
 #include <QHash>
-#include <QMap>
 #include <QPointer>
+#include <QTimer>
 #include <QVector>
+#include <QtAlgorithms>
+// STL
+#include <array>
+#include <atomic>
+#include <bitset>
 // Wayland
 #include <wayland-server.h>
 
@@ -35,13 +40,18 @@ namespace KWayland
 namespace Server
 {
 
+class ClientConnection;
 class DataDeviceInterface;
+class PointerPinchGestureInterface;
+class PointerSwipeGestureInterface;
+class RelativePointerInterface;
 class TextInputInterface;
 
 class SeatInterface::Private : public Global::Private
 {
 public:
     Private(SeatInterface *q, Display *d);
+    ~Private() override;
     void bind(wl_client *client, uint32_t version, uint32_t id) override;
     void sendCapabilities(wl_resource *r);
     void sendName(wl_resource *r);
@@ -66,16 +76,30 @@ public:
     QVector<TouchInterface*> touchs;
     QVector<DataDeviceInterface*> dataDevices;
     QVector<TextInputInterface*> textInputs;
+    // the devices by client, to find the devices for a focused surface
+    QHash<ClientConnection*, QVector<PointerInterface*>> clientPointers;
+    QHash<ClientConnection*, QVector<KeyboardInterface*>> clientKeyboards;
+    QHash<ClientConnection*, QVector<TouchInterface*>> clientTouchs;
+    QHash<ClientConnection*, QVector<DataDeviceInterface*>> clientDataDevices;
+    QHash<ClientConnection*, QVector<TextInputInterface*>> clientTextInputs;
     DataDeviceInterface *currentSelection = nullptr;
 
+    // Linux key and button codes are bounded by KEY_MAX, higher codes are not tracked
+    static constexpr quint32 s_keyCount = 0x300;
+    // the maximum number of touch points at the same time
+    static constexpr qint32 s_touchSlotCount = 64;
+    // the capacity of the input queue, a power of two
+    static constexpr quint32 s_inputQueueSize = 1024;
+
     // Pointer related members
     struct Pointer {
         enum class State {
             Released,
             Pressed
         };
-        QHash<quint32, quint32> buttonSerials;
-        QHash<quint32, State> buttonStates;
+        std::array<quint32, s_keyCount> buttonSerials{};
+        std::bitset<s_keyCount> buttonStates;
+        QVector<quint32> pressedButtons;
         QPointF pos;
         struct Focus {
             SurfaceInterface *surface = nullptr;
@@ -83,7 +107,29 @@ public:
             QMetaObject::Connection destroyConnection;
             QPointF offset = QPointF();
             QMatrix4x4 transformation;
+            // how the transformation maps a global position, to take the cheapest path
+            enum class TransformationType {
+                Identity,
+                Translation,
+                Scale,
+                General
+            };
+            TransformationType transformationType = TransformationType::Identity;
+            QPointF translation;
+            qreal xScale = 1.0;
+            qreal yScale = 1.0;
             quint32 serial = 0;
+            // the relative pointers and gestures of the focused pointers, built on first use
+            struct RelativePointer {
+                PointerInterface *pointer;
+                RelativePointerInterface *relativePointer;
+            };
+            QVector<RelativePointer> relativePointers;
+            QVector<PointerSwipeGestureInterface*> swipeGestures;
+            QVector<PointerPinchGestureInterface*> pinchGestures;
+            bool targetsValid = false;
+            void setTransformation(const QMatrix4x4 &matrix);
+            QPointF mapToSurface(const QPointF &globalPosition) const;
         };
         Focus focus;
         QPointer<SurfaceInterface> gestureSurface;
@@ -91,6 +137,18 @@ public:
     Pointer globalPointer;
     void updatePointerButtonSerial(quint32 button, quint32 serial);
     void updatePointerButtonState(quint32 button, Pointer::State state);
+    /**
+     * Marks the relative pointer and gesture targets of the pointer focus as outdated.
+     * Invoked whenever a focused pointer or one of their relative pointers or gestures
+     * gets added or removed.
+     **/
+    void invalidatePointerTargets();
+    void updatePointerTargets();
+    /**
+     * @returns whether gestures go to the targets of the pointer focus
+     **/
+    bool isGestureOnPointerFocus();
+    void sendRelativePointerMotion(const QSizeF &delta, const QSizeF &deltaNonAccelerated, quint64 microseconds);
 
     // Keyboard related members
     struct Keyboard {
@@ -98,13 +156,26 @@ public:
             Released,
             Pressed
         };
-        QHash<quint32, State> states;
+        std::bitset<s_keyCount> states;
+        // the keys which got pressed or released at least once
+        std::bitset<s_keyCount> known;
+        // in the order of pressing
+        QVector<quint32> pressedKeys;
         struct Keymap {
             int fd = -1;
             quint32 size = 0;
             bool xkbcommonCompatible = false;
+            // whether fd is a sealed file owned by the keymap cache
+            bool shared = false;
         };
         Keymap keymap;
+        struct KeymapFile {
+            QByteArray hash;
+            int fd = -1;
+            quint32 size = 0;
+        };
+        // the shared keymap files, least recently used first
+        QVector<KeymapFile> keymapCache;
         struct Modifiers {
             quint32 depressed = 0;
             quint32 latched = 0;
@@ -129,6 +200,11 @@ public:
     };
     Keyboard keys;
     bool updateKey(quint32 key, Keyboard::State state);
+    /**
+     * @returns the cached keymap file for @p content, creating it if needed
+     **/
+    Keyboard::KeymapFile keymapFile(const QByteArray &content);
+    void sendKeymap(KeyboardInterface *keyboard);
 
     struct TextInput {
         struct Focus {
@@ -151,9 +227,113 @@ public:
             QPointF firstTouchPos;
         };
         Focus focus;
-        QMap<qint32, quint32> ids;
+        // a touch point id is its slot, a bit is set for each active touch point
+        quint64 ids = 0;
+        std::array<quint32, s_touchSlotCount> serials{};
+        bool isActive(qint32 id) const {
+            return id >= 0 && id < s_touchSlotCount && (ids & (quint64(1) << id));
+        }
+        qint32 firstId() const {
+            return qCountTrailingZeroBits(ids);
+        }
     };
     Touch globalTouch;
+    void sendTouchMotion(qint32 id, const QPointF &globalPosition);
+
+    // Input frame related members, also used for the motion held back from a backlogged client
+    struct InputFrame {
+        int depth = 0;
+        bool pointerMotion = false;
+        bool verticalAxis = false;
+        quint32 verticalAxisDelta = 0;
+        bool horizontalAxis = false;
+        quint32 horizontalAxisDelta = 0;
+        // relative motion accumulated while the client is backlogged
+        bool relativeMotion = false;
+        QSizeF relativeDelta;
+        QSizeF relativeDeltaNonAccelerated;
+        quint64 relativeMicroseconds = 0;
+        // the moved touch points by slot and their latest global position
+        quint64 touchMotion = 0;
+        std::array<QPointF, s_touchSlotCount> touchMotionPositions;
+        bool touchFrame = false;
+        // pointers with a deferred frame event
+        QVector<QPointer<PointerInterface>> pointers;
+    };
+    InputFrame inputFrame;
+    quint64 inputEventsReceived = 0;
+    quint64 inputEventsSent = 0;
+    void deferPointerFrames(const QVector<PointerInterface*> &pointers);
+    void sendPointerMotion();
+    void sendPointerAxis(Qt::Orientation orientation, quint32 delta);
+    /**
+     * Sends the motion and axis events collected in the current input frame.
+     **/
+    void flushPointerEvents();
+    /**
+     * Sends the collected motion of all touch points.
+     **/
+    void flushTouchMotion();
+    void sendTouchFrame();
+
+    /**
+     * @returns whether the client of @p surface did not read a lot of the sent events
+     * as of its last flush, see ClientConnection::unreadBytes
+     **/
+    bool isBacklogged(SurfaceInterface *surface) const;
+    /**
+     * Sends the motion held back from backlogged clients once they caught up, otherwise
+     * checks again later.
+     **/
+    void flushBackloggedMotion();
+    QTimer *backlogTimer = nullptr;
+
+    // Input queue related members
+    struct QueuedInputEvent {
+        enum class Type {
+            PointerMotion,
+            PointerButtonPress,
+            PointerButtonRelease,
+            PointerAxis,
+            KeyPress,
+            KeyRelease,
+            TouchDown,
+            TouchMotion,
+            TouchUp,
+            Frame
+        };
+        Type type;
+        quint32 time;
+        // the button, key, axis orientation or touch id
+        quint32 code;
+        // the axis delta
+        quint32 value;
+        QPointF position;
+    };
+    struct InputQueue {
+        // the index of the next event to write, only written by the producer thread
+        std::atomic<quint32> head{0};
+        std::array<QueuedInputEvent, s_inputQueueSize> events;
+        // the index of the next event to read, only written by the Display thread
+        std::atomic<quint32> tail{0};
+        // whether the eventfd got signalled since the last drain
+        std::atomic<bool> wakeupPending{false};
+        // whether the producer terminates its frames with a Frame event
+        std::atomic<bool> framed{false};
+        int fd = -1;
+        wl_event_source *source = nullptr;
+        // the touch ids assigned by touchDown by the id chosen by the producer
+        std::array<qint32, s_touchSlotCount> touchIds;
+    };
+    InputQueue inputQueue;
+    /**
+     * Pushes @p event into the input queue, may be called from any thread.
+     **/
+    bool queueInputEvent(const QueuedInputEvent &event);
+    void dispatchInputQueue();
+    void addInputQueueSource();
+    void removeInputQueueSource();
+    static int inputQueueCallback(int fd, uint32_t mask, void *data);
 
     struct Drag {
         enum class Mode {
@@ -196,6 +376,9 @@ private:
     static const qint32 s_pointerVersion;
     static const qint32 s_touchVersion;
     static const qint32 s_keyboardVersion;
+    static const int s_keymapCacheSize;
+    static const quint32 s_backlogThreshold;
+    static const int s_backlogRetryInterval;
 
     SeatInterface *q;
 };
@@ -39,6 +39,169 @@ namespace KWayland
 namespace Server
 {
 
+static bool isTransposed(OutputInterface::Transform transform)
+{
+    switch (transform) {
+    case OutputInterface::Transform::Rotated90:
+    case OutputInterface::Transform::Rotated270:
+    case OutputInterface::Transform::Flipped90:
+    case OutputInterface::Transform::Flipped270:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static QRect rectFromCorners(int x1, int y1, int x2, int y2)
+{
+    return QRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+/**
+ * Applies the @p transform to @p rect inside an area of @p width x @p height.
+ **/
+static QRect transformRect(const QRect &rect, int width, int height, OutputInterface::Transform transform)
+{
+    const int x1 = rect.x();
+    const int y1 = rect.y();
+    const int x2 = rect.x() + rect.width();
+    const int y2 = rect.y() + rect.height();
+    switch (transform) {
+    case OutputInterface::Transform::Rotated90:
+        return rectFromCorners(y1, width - x2, y2, width - x1);
+    case OutputInterface::Transform::Rotated180:
+        return rectFromCorners(width - x2, height - y2, width - x1, height - y1);
+    case OutputInterface::Transform::Rotated270:
+        return rectFromCorners(height - y2, x1, height - y1, x2);
+    case OutputInterface::Transform::Flipped:
+        return rectFromCorners(width - x2, y1, width - x1, y2);
+    case OutputInterface::Transform::Flipped90:
+        return rectFromCorners(height - y2, width - x2, height - y1, width - x1);
+    case OutputInterface::Transform::Flipped180:
+        return rectFromCorners(x1, height - y2, x2, height - y1);
+    case OutputInterface::Transform::Flipped270:
+        return rectFromCorners(y1, x1, y2, x2);
+    case OutputInterface::Transform::Normal:
+    default:
+        return rect;
+    }
+}
+
+static OutputInterface::Transform invertedTransform(OutputInterface::Transform transform)
+{
+    // the flipped transforms are reflections and thus their own inverse
+    switch (transform) {
+    case OutputInterface::Transform::Rotated90:
+        return OutputInterface::Transform::Rotated270;
+    case OutputInterface::Transform::Rotated270:
+        return OutputInterface::Transform::Rotated90;
+    default:
+        return transform;
+    }
+}
+
+/**
+ * Maps @p region from surface-local coordinates to buffer coordinates.
+ **/
+static QRegion mapToBuffer(const QRegion &region, const QSize &surfaceSize, qint32 scale, OutputInterface::Transform transform)
+{
+    if (scale == 1 && transform == OutputInterface::Transform::Normal) {
+        return region;
+    }
+    QRegion mapped;
+    for (const QRect &rect : region) {
+        const QRect r = transformRect(rect, surfaceSize.width(), surfaceSize.height(), transform);
+        mapped += QRect(r.x() * scale, r.y() * scale, r.width() * scale, r.height() * scale);
+    }
+    return mapped;
+}
+
+/**
+ * Maps @p region from buffer coordinates to surface-local coordinates, rounding outwards.
+ **/
+static QRegion mapFromBuffer(const QRegion &region, const QSize &bufferSize, qint32 scale, OutputInterface::Transform transform)
+{
+    if (scale == 1 && transform == OutputInterface::Transform::Normal) {
+        return region;
+    }
+    const QSize scaledSize = bufferSize / scale;
+    QRegion mapped;
+    for (const QRect &rect : region.intersected(QRect(QPoint(0, 0), bufferSize))) {
+        const QRect scaled = rectFromCorners(rect.x() / scale,
+                                             rect.y() / scale,
+                                             (rect.x() + rect.width() + scale - 1) / scale,
+                                             (rect.y() + rect.height() + scale - 1) / scale);
+        mapped += transformRect(scaled, scaledSize.width(), scaledSize.height(), invertedTransform(transform));
+    }
+    return mapped;
+}
+
+/**
+ * Builds the region covered by @p rects in one sweep instead of uniting the rects one by one.
+ * The rects get sorted by their top edge, the content of @p rects is undefined afterwards.
+ **/
+static QRegion unitedRects(QVector<QRect> *rects)
+{
+    if (rects->count() == 1) {
+        return QRegion(rects->first());
+    }
+    std::sort(rects->begin(), rects->end(), [] (const QRect &a, const QRect &b) { return a.top() < b.top(); });
+    // the horizontal bands of the region start at each top edge and after each bottom edge
+    QVector<int> edges;
+    edges.reserve(rects->count() * 2);
+    for (const QRect &rect : qAsConst(*rects)) {
+        edges << rect.top() << rect.bottom() + 1;
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    QVector<QRect> bands;
+    QVector<QRect> active;
+    QVector<QPair<int, int>> spans;
+    QVector<QPair<int, int>> previousSpans;
+    int next = 0;
+    for (int i = 0; i + 1 < edges.count(); ++i) {
+        const int top = edges.at(i);
+        const int bottom = edges.at(i + 1) - 1;
+        active.erase(std::remove_if(active.begin(), active.end(), [top] (const QRect &rect) { return rect.bottom() < top; }), active.end());
+        while (next < rects->count() && rects->at(next).top() == top) {
+            active << rects->at(next++);
+        }
+        // the horizontal spans of the band, touching spans are joined
+        spans.clear();
+        for (const QRect &rect : qAsConst(active)) {
+            spans << qMakePair(rect.left(), rect.right() + 1);
+        }
+        std::sort(spans.begin(), spans.end());
+        int merged = 0;
+        for (int j = 1; j < spans.count(); ++j) {
+            if (spans.at(j).first <= spans.at(merged).second) {
+                spans[merged].second = qMax(spans.at(merged).second, spans.at(j).second);
+            } else {
+                spans[++merged] = spans.at(j);
+            }
+        }
+        spans.resize(spans.isEmpty() ? 0 : merged + 1);
+        if (spans == previousSpans && !spans.isEmpty()) {
+            // the band continues the previous one, grow its rects downwards
+            for (int j = bands.count() - spans.count(); j < bands.count(); ++j) {
+                bands[j].setBottom(bottom);
+            }
+            continue;
+        }
+        for (const auto &span : qAsConst(spans)) {
+            bands << QRect(QPoint(span.first, top), QPoint(span.second - 1, bottom));
+        }
+        std::swap(spans, previousSpans);
+    }
+    QRegion region;
+    region.setRects(bands.constData(), bands.count());
+    return region;
+}
+
+const int SurfaceInterface::Private::s_defaultMaxDamageRects = 64;
+const int SurfaceInterface::Private::s_damageRectsBatch = 1024;
+
 SurfaceInterface::Private::Private(SurfaceInterface *q, CompositorInterface *c, wl_resource *parentResource)
     : Resource::Private(q, c, parentResource, &wl_surface_interface, &s_interface)
 {
@@ -274,13 +437,21 @@ const struct wl_surface_interface SurfaceInterface::Private::s_interface = {
     inputRegionCallback,
     commitCallback,
     bufferTransformCallback,
-    bufferScaleCallback
+    bufferScaleCallback,
+    damageBufferCallback
 };
 #endif
 
 SurfaceInterface::SurfaceInterface(CompositorInterface *parent, wl_resource *parentResource)
     : Resource(new Private(this, parent, parentResource))
 {
+    // the signal gets also emitted for changes in the tree of all descendants
+    connect(this, &SurfaceInterface::subSurfaceTreeChanged, this,
+        [this] {
+            Q_D();
+            d->hitTestEntriesValid = false;
+        }
+    );
 }
 
 SurfaceInterface::~SurfaceInterface() = default;
@@ -288,23 +459,29 @@ SurfaceInterface::~SurfaceInterface() = default;
 void SurfaceInterface::frameRendered(quint32 msec)
 {
     Q_D();
+    // the sub-surfaces belong to the same client, so one flush for the whole tree is sufficient
+    if (d->sendFrameCallbacks(msec)) {
+        client()->flush();
+    }
+}
+
+bool SurfaceInterface::Private::sendFrameCallbacks(quint32 msec)
+{
     // notify all callbacks
-    const bool needsFlush = !d->current.callbacks.isEmpty();
-    while (!d->current.callbacks.isEmpty()) {
-        wl_resource *r = d->current.callbacks.takeFirst();
+    bool sent = !current.callbacks.isEmpty();
+    while (!current.callbacks.isEmpty()) {
+        wl_resource *r = current.callbacks.takeFirst();
         wl_callback_send_done(r, msec);
         wl_resource_destroy(r);
     }
-    for (auto it = d->current.children.constBegin(); it != d->current.children.constEnd(); ++it) {
+    for (auto it = current.children.constBegin(); it != current.children.constEnd(); ++it) {
         const auto &subSurface = *it;
         if (subSurface.isNull() || subSurface->d_func()->surface.isNull()) {
             continue;
         }
-        subSurface->d_func()->surface->frameRendered(msec);
-    }
-    if (needsFlush)  {
-        client()->flush();
+        sent = subSurface->d_func()->surface->d_func()->sendFrameCallbacks(msec) || sent;
     }
+    return sent;
 }
 
 void SurfaceInterface::Private::destroy()
@@ -345,21 +522,21 @@ void SurfaceInterface::Private::swapStates(State *source, State *target, bool em
     if (bufferChanged) {
         // TODO: is the reffing correct for subsurfaces?
         QSize oldSize;
+        // the BufferInterface is shared between attaches of the same wl_buffer,
+        // so reference the new one first to not release a re-attached buffer
+        if (source->buffer && emitChanged) {
+            source->buffer->setSurface(q);
+            source->buffer->ref();
+        }
         if (target->buffer) {
             oldSize = target->buffer->size();
             if (emitChanged) {
                 target->buffer->unref();
-                QObject::disconnect(target->buffer, &BufferInterface::sizeChanged, q, &SurfaceInterface::sizeChanged);
             } else {
-                delete target->buffer;
                 target->buffer = nullptr;
             }
         }
         if (source->buffer) {
-            if (emitChanged) {
-                source->buffer->ref();
-                QObject::connect(source->buffer, &BufferInterface::sizeChanged, q, &SurfaceInterface::sizeChanged);
-            }
             const QSize newSize = source->buffer->size();
             sizeChanged = newSize.isValid() && newSize != oldSize;
         }
@@ -369,51 +546,83 @@ void SurfaceInterface::Private::swapStates(State *source, State *target, bool em
         }
         buffer = source->buffer;
     }
-    // copy values
+    // move values, the source state gets reset without reallocating its members;
+    // the damage handling below still allocates for non empty damage, see the documentation of swapStates
     if (bufferChanged) {
         target->buffer = buffer;
-        target->damage = source->damage;
+        target->damage = std::move(source->damage);
+        target->bufferDamage = std::move(source->bufferDamage);
         target->bufferIsSet = source->bufferIsSet;
     }
+    source->buffer = nullptr;
+    source->damage = QRegion();
+    source->bufferDamage = QRegion();
+    source->bufferIsSet = false;
     if (childrenChanged) {
-        target->childrenChanged = source->childrenChanged;
+        // the source keeps its children as they are the reference for the next pending state
+        target->childrenChanged = true;
         target->children = source->children;
+        source->childrenChanged = false;
+    }
+    if (target->callbacks.isEmpty()) {
+        // reuse the storage of the already processed callbacks
+        target->callbacks.swap(source->callbacks);
+    } else if (!source->callbacks.isEmpty()) {
+        target->callbacks.append(source->callbacks);
+        source->callbacks.clear();
     }
-    target->callbacks.append(source->callbacks);
 
     if (shadowChanged) {
         target->shadow = source->shadow;
         target->shadowIsSet = true;
+        source->shadow.clear();
+        source->shadowIsSet = false;
     }
     if (blurChanged) {
         target->blur = source->blur;
         target->blurIsSet = true;
+        source->blur.clear();
+        source->blurIsSet = false;
     }
     if (contrastChanged) {
         target->contrast = source->contrast;
         target->contrastIsSet = true;
+        source->contrast.clear();
+        source->contrastIsSet = false;
     }
     if (slideChanged) {
         target->slide = source->slide;
         target->slideIsSet = true;
+        source->slide.clear();
+        source->slideIsSet = false;
     }
     if (inputRegionChanged) {
-        target->input = source->input;
+        target->input = std::move(source->input);
         target->inputIsInfinite = source->inputIsInfinite;
         target->inputIsSet = true;
+        source->input = QRegion();
+        source->inputIsInfinite = true;
+        source->inputIsSet = false;
     }
     if (opaqueRegionChanged) {
-        target->opaque = source->opaque;
+        target->opaque = std::move(source->opaque);
         target->opaqueIsSet = true;
+        source->opaque = QRegion();
+        source->opaqueIsSet = false;
     }
     if (scaleFactorChanged) {
         target->scale = source->scale;
         target->scaleIsSet = true;
     }
+    source->scale = 1;
+    source->scaleIsSet = false;
     if (transformChanged) {
         target->transform = source->transform;
         target->transformIsSet = true;
     }
+    source->transform = OutputInterface::Transform::Normal;
+    source->transformIsSet = false;
+    source->offset = QPoint();
     if (!lockedPointer.isNull()) {
         lockedPointer->d_func()->commit();
     }
@@ -421,31 +630,71 @@ void SurfaceInterface::Private::swapStates(State *source, State *target, bool em
         confinedPointer->d_func()->commit();
     }
 
-    *source = State{};
-    source->children = target->children;
+    StateChanges changes;
     if (opaqueRegionChanged) {
+        changes |= StateChange::Opaque;
         emit q->opaqueChanged(target->opaque);
     }
     if (inputRegionChanged) {
+        changes |= StateChange::Input;
         emit q->inputChanged(target->input);
     }
     if (scaleFactorChanged) {
+        changes |= StateChange::Scale;
         emit q->scaleChanged(target->scale);
         if (buffer && !sizeChanged) {
+            changes |= StateChange::Size;
             emit q->sizeChanged();
         }
     }
     if (transformChanged) {
+        changes |= StateChange::Transform;
         emit q->transformChanged(target->transform);
     }
     if (bufferChanged && emitChanged) {
-        if (target->buffer && !target->damage.isEmpty()) {
-            const QRegion windowRegion = QRegion(0, 0, q->size().width(), q->size().height());
-            if (!windowRegion.isEmpty()) {
-                target->damage = windowRegion.intersected(target->damage);
+        changes |= StateChange::Buffer;
+        if (target->buffer && (!target->damage.isEmpty() || !target->bufferDamage.isEmpty())) {
+            const QRect windowRect = QRect(QPoint(0, 0), q->size());
+            if (!windowRect.isEmpty()) {
+                if (target->scale == 1 && target->transform == OutputInterface::Transform::Normal) {
+                    // both damages are in the same coordinates, they share the region data
+                    if (target->damage.isEmpty()) {
+                        target->damage = std::move(target->bufferDamage);
+                    } else if (!target->bufferDamage.isEmpty()) {
+                        target->damage += target->bufferDamage;
+                        limitDamage(&target->damage);
+                    }
+                    if (!windowRect.contains(target->damage.boundingRect())) {
+                        target->damage = target->damage.intersected(windowRect);
+                    }
+                    target->bufferDamage = target->damage;
+                } else {
+                    // clip first, clients without damage_buffer damage the whole surface with a huge rect
+                    if (!windowRect.contains(target->damage.boundingRect())) {
+                        target->damage = target->damage.intersected(windowRect);
+                    }
+                    // combine the damage in surface and buffer coordinates
+                    const QRegion surfaceDamage = target->damage;
+                    if (!target->bufferDamage.isEmpty()) {
+                        target->damage += mapFromBuffer(target->bufferDamage, target->buffer->size(), target->scale, target->transform);
+                        limitDamage(&target->damage);
+                    }
+                    if (!surfaceDamage.isEmpty()) {
+                        target->bufferDamage += mapToBuffer(surfaceDamage, windowRect.size(), target->scale, target->transform);
+                        limitDamage(&target->bufferDamage);
+                    }
+                    const QRect bufferRect = QRect(QPoint(0, 0), target->buffer->size());
+                    if (!bufferRect.contains(target->bufferDamage.boundingRect())) {
+                        target->bufferDamage = target->bufferDamage.intersected(bufferRect);
+                    }
+                    if (!windowRect.contains(target->damage.boundingRect())) {
+                        target->damage = target->damage.intersected(windowRect);
+                    }
+                }
                 if (emitChanged) {
                     subSurfaceIsMapped = true;
-                    trackedDamage = trackedDamage.united(target->damage);
+                    trackDamage(target->damage);
+                    changes |= StateChange::Damage;
                     emit q->damaged(target->damage);
                     // workaround for https://bugreports.qt.io/browse/QTBUG-52092
                     // if the surface is a sub-surface, but the main surface is not yet mapped, fake frame rendered
@@ -459,35 +708,45 @@ void SurfaceInterface::Private::swapStates(State *source, State *target, bool em
             }
         } else if (!target->buffer && emitChanged) {
             subSurfaceIsMapped = false;
+            changes |= StateChange::Unmapped;
             emit q->unmapped();
         }
     }
     if (!emitChanged) {
         return;
     }
+    invalidateHitTestEntries();
     if (sizeChanged) {
+        changes |= StateChange::Size;
         emit q->sizeChanged();
     }
     if (shadowChanged) {
+        changes |= StateChange::Shadow;
         emit q->shadowChanged();
     }
     if (blurChanged) {
+        changes |= StateChange::Blur;
         emit q->blurChanged();
     }
     if (contrastChanged) {
+        changes |= StateChange::Contrast;
         emit q->contrastChanged();
     }
     if (slideChanged) {
+        changes |= StateChange::SlideOnShowHide;
         emit q->slideOnShowHideChanged();
     }
     if (childrenChanged) {
+        changes |= StateChange::SubSurfaceTree;
         emit q->subSurfaceTreeChanged();
     }
+    emit q->stateCommitted(changes);
 }
 
 void SurfaceInterface::Private::commit()
 {
     Q_Q(SurfaceInterface);
+    mergePendingDamage();
     if (!subSurface.isNull() && subSurface->isSynchronized()) {
         swapStates(&pending, &subSurfacePending, false);
     } else {
@@ -526,7 +785,85 @@ void SurfaceInterface::Private::commitSubSurface()
 
 void SurfaceInterface::Private::damage(const QRect &rect)
 {
-    pending.damage = pending.damage.united(rect);
+    if (rect.isEmpty()) {
+        return;
+    }
+    pendingDamageRects.append(rect);
+    if (pendingDamageRects.count() >= s_damageRectsBatch) {
+        // bounds the pending rects of a client damaging without committing
+        mergeDamageRects(&pendingDamageRects, &pending.damage);
+    }
+}
+
+void SurfaceInterface::Private::damageBuffer(const QRect &rect)
+{
+    if (rect.isEmpty()) {
+        return;
+    }
+    pendingBufferDamageRects.append(rect);
+    if (pendingBufferDamageRects.count() >= s_damageRectsBatch) {
+        mergeDamageRects(&pendingBufferDamageRects, &pending.bufferDamage);
+    }
+}
+
+void SurfaceInterface::Private::mergePendingDamage()
+{
+    mergeDamageRects(&pendingDamageRects, &pending.damage);
+    mergeDamageRects(&pendingBufferDamageRects, &pending.bufferDamage);
+}
+
+void SurfaceInterface::Private::mergeDamageRects(QVector<QRect> *rects, QRegion *region) const
+{
+    if (rects->isEmpty()) {
+        return;
+    }
+    if (maxDamageRects > 0 && rects->count() > maxDamageRects) {
+        // too fragmented, the bounding rect is cheaper to process than the exact region
+        QRect boundingRect = region->boundingRect();
+        for (const QRect &rect : qAsConst(*rects)) {
+            boundingRect |= rect;
+        }
+        *region = QRegion(boundingRect);
+    } else {
+        for (const QRect &rect : *region) {
+            rects->append(rect);
+        }
+        *region = unitedRects(rects);
+        limitDamage(region);
+    }
+    // keeps the capacity for the next frame
+    rects->clear();
+}
+
+void SurfaceInterface::Private::trackDamage(const QRegion &damage)
+{
+    if (damage.isEmpty()) {
+        return;
+    }
+    if (trackedDamage.isEmpty()) {
+        // shares the region data
+        trackedDamage = damage;
+        return;
+    }
+    const QRect boundingRect = trackedDamage.boundingRect() | damage.boundingRect();
+    if (trackedDamage.rectCount() == 1 && trackedDamage.boundingRect() == boundingRect) {
+        // already covered, e.g. by a previous damage of the whole surface
+        return;
+    }
+    if (maxDamageRects > 0 && trackedDamage.rectCount() + damage.rectCount() > maxDamageRects) {
+        // the union would be too fragmented as well, skip building it
+        trackedDamage = QRegion(boundingRect);
+        return;
+    }
+    trackedDamage += damage;
+    limitDamage(&trackedDamage);
+}
+
+void SurfaceInterface::Private::limitDamage(QRegion *region) const
+{
+    if (maxDamageRects > 0 && region->rectCount() > maxDamageRects) {
+        *region = QRegion(region->boundingRect());
+    }
 }
 
 void SurfaceInterface::Private::setScale(qint32 scale)
@@ -538,6 +875,7 @@ void SurfaceInterface::Private::setScale(qint32 scale)
 void SurfaceInterface::Private::setTransform(OutputInterface::Transform transform)
 {
     pending.transform = transform;
+    pending.transformIsSet = true;
 }
 
 void SurfaceInterface::Private::addFrameCallback(uint32_t callback)
@@ -555,18 +893,25 @@ void SurfaceInterface::Private::attachBuffer(wl_resource *buffer, const QPoint &
 {
     pending.bufferIsSet = true;
     pending.offset = offset;
-    if (pending.buffer) {
-        delete pending.buffer;
-    }
     if (!buffer) {
         // got a null buffer, deletes content in next frame
         pending.buffer = nullptr;
         pending.damage = QRegion();
+        pending.bufferDamage = QRegion();
+        pendingDamageRects.clear();
+        pendingBufferDamageRects.clear();
         return;
     }
     Q_Q(SurfaceInterface);
-    pending.buffer = new BufferInterface(buffer, q);
-    QObject::connect(pending.buffer, &BufferInterface::aboutToBeDestroyed, q,
+    // clients cycle through a small set of wl_buffers, reuse the BufferInterface of a known one
+    BufferInterface *b = BufferInterface::get(buffer);
+    b->setSurface(q);
+    pending.buffer = b;
+    if (knownBuffers.contains(b)) {
+        return;
+    }
+    knownBuffers << b;
+    QObject::connect(b, &BufferInterface::aboutToBeDestroyed, q,
         [this](BufferInterface *buffer) {
             if (pending.buffer == buffer) {
                 pending.buffer = nullptr;
@@ -580,6 +925,18 @@ void SurfaceInterface::Private::attachBuffer(wl_resource *buffer, const QPoint &
             }
         }
     );
+    QObject::connect(b, &BufferInterface::sizeChanged, q,
+        [this, b] {
+            if (current.buffer == b) {
+                emit q_func()->sizeChanged();
+            }
+        }
+    );
+    QObject::connect(b, &QObject::destroyed, q,
+        [this, b] {
+            knownBuffers.removeOne(b);
+        }
+    );
 }
 
 void SurfaceInterface::Private::destroyFrameCallback(wl_resource *r)
@@ -656,12 +1013,24 @@ void SurfaceInterface::Private::bufferScaleCallback(wl_client *client, wl_resour
     cast<Private>(resource)->setScale(scale);
 }
 
+void SurfaceInterface::Private::damageBufferCallback(wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+    Q_UNUSED(client)
+    cast<Private>(resource)->damageBuffer(QRect(x, y, width, height));
+}
+
 QRegion SurfaceInterface::damage() const
 {
     Q_D();
     return d->current.damage;
 }
 
+QRegion SurfaceInterface::bufferDamage() const
+{
+    Q_D();
+    return d->current.bufferDamage;
+}
+
 QRegion SurfaceInterface::opaque() const
 {
     Q_D();
@@ -734,9 +1103,9 @@ QPointer< SubSurfaceInterface > SurfaceInterface::subSurface() const
 QSize SurfaceInterface::size() const
 {
     Q_D();
-    // TODO: apply transform to the buffer size
     if (d->current.buffer) {
-        return d->current.buffer->size() / scale();
+        const QSize size = d->current.buffer->size() / scale();
+        return isTransposed(d->current.transform) ? size.transposed() : size;
     }
     return QSize();
 }
@@ -788,6 +1157,18 @@ void SurfaceInterface::resetTrackedDamage()
     d->trackedDamage = QRegion();
 }
 
+void SurfaceInterface::setMaxDamageRects(int count)
+{
+    Q_D();
+    d->maxDamageRects = qMax(0, count);
+}
+
+int SurfaceInterface::maxDamageRects() const
+{
+    Q_D();
+    return d->maxDamageRects;
+}
+
 QVector<OutputInterface *> SurfaceInterface::outputs() const
 {
     Q_D();
@@ -832,57 +1213,80 @@ void SurfaceInterface::setOutputs(const QVector<OutputInterface *> &outputs)
     d->outputs = outputs;
 }
 
-SurfaceInterface *SurfaceInterface::surfaceAt(const QPointF &position)
+void SurfaceInterface::Private::invalidateHitTestEntries()
 {
-    if (!isMapped()) {
-        return nullptr;
+    // the hit test entries of all ancestors include this surface
+    for (Private *p = this; p; ) {
+        p->hitTestEntriesValid = false;
+        if (p->subSurface.isNull() || p->subSurface->parentSurface().isNull()) {
+            break;
+        }
+        p = p->subSurface->parentSurface()->d_func();
     }
-    Q_D();
+}
+
+void SurfaceInterface::Private::collectHitTestEntries(SurfaceInterface *surface, const QPoint &offset, QVector<HitTestEntry> *entries)
+{
     // go from top to bottom. Top most child is last in list
-    QListIterator<QPointer<SubSurfaceInterface>> it(d->current.children);
-    it.toBack();
-    while (it.hasPrevious()) {
-        const auto &current = it.previous();
-        auto surface = current->surface();
-        if (surface.isNull()) {
+    const auto &children = surface->d_func()->current.children;
+    for (auto it = children.crbegin(); it != children.crend(); ++it) {
+        const auto &current = *it;
+        if (current.isNull()) {
             continue;
         }
-        if (auto s = surface->surfaceAt(position - current->position())) {
-            return s;
+        auto child = current->surface();
+        if (child.isNull() || !child->isMapped()) {
+            continue;
         }
+        collectHitTestEntries(child.data(), offset + current->position(), entries);
     }
-    // check whether the geometry contains the pos
-    if (!size().isEmpty() && QRectF(QPoint(0, 0), size()).contains(position)) {
-        return this;
+    const QSize size = surface->size();
+    if (!size.isEmpty()) {
+        entries->append({surface, offset, size});
+    }
+}
+
+void SurfaceInterface::Private::updateHitTestEntries()
+{
+    if (hitTestEntriesValid) {
+        return;
+    }
+    // keeps the capacity
+    hitTestEntries.clear();
+    collectHitTestEntries(q_func(), QPoint(0, 0), &hitTestEntries);
+    hitTestEntriesValid = true;
+}
+
+SurfaceInterface *SurfaceInterface::surfaceAt(const QPointF &position)
+{
+    if (!isMapped()) {
+        return nullptr;
+    }
+    Q_D();
+    d->updateHitTestEntries();
+    for (const auto &entry : qAsConst(d->hitTestEntries)) {
+        // check whether the geometry contains the pos
+        if (QRectF(QPoint(0, 0), entry.size).contains(position - entry.offset)) {
+            return entry.surface;
+        }
     }
     return nullptr;
 }
 
 SurfaceInterface *SurfaceInterface::inputSurfaceAt(const QPointF &position)
 {
-    // TODO: Most of this is very similar to SurfaceInterface::surfaceAt
-    //       Is there a way to reduce the code duplication?
     if (!isMapped()) {
         return nullptr;
     }
     Q_D();
-    // go from top to bottom. Top most child is last in list
-    QListIterator<QPointer<SubSurfaceInterface>> it(d->current.children);
-    it.toBack();
-    while (it.hasPrevious()) {
-        const auto &current = it.previous();
-        auto surface = current->surface();
-        if (surface.isNull()) {
-            continue;
+    d->updateHitTestEntries();
+    for (const auto &entry : qAsConst(d->hitTestEntries)) {
+        // check whether the geometry and input region contain the pos
+        const QPointF local = position - entry.offset;
+        if (QRectF(QPoint(0, 0), entry.size).contains(local) &&
+                (entry.surface->inputIsInfinite() || entry.surface->input().contains(local.toPoint()))) {
+            return entry.surface;
         }
-        if (auto s = surface->inputSurfaceAt(position - current->position())) {
-            return s;
-        }
-    }
-    // check whether the geometry and input region contain the pos
-    if (!size().isEmpty() && QRectF(QPoint(0, 0), size()).contains(position) &&
-            (inputIsInfinite() || input().contains(position.toPoint()))) {
-        return this;
     }
     return nullptr;
 }
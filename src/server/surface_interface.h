@@ -94,9 +94,91 @@ class KWAYLANDSERVER_EXPORT SurfaceInterface : public Resource
 public:
     virtual ~SurfaceInterface();
 
+    /**
+     * The parts of the state which changed in a commit.
+     * @see stateCommitted
+     * @since 5.58
+     **/
+    enum class StateChange {
+        /**
+         * A new BufferInterface or a null buffer got committed
+         **/
+        Buffer = 1 << 0,
+        /**
+         * The surface got damaged, see damaged
+         **/
+        Damage = 1 << 1,
+        /**
+         * The opaque region changed, see opaqueChanged
+         **/
+        Opaque = 1 << 2,
+        /**
+         * The input region changed, see inputChanged
+         **/
+        Input = 1 << 3,
+        /**
+         * The buffer scale changed, see scaleChanged
+         **/
+        Scale = 1 << 4,
+        /**
+         * The buffer transform changed, see transformChanged
+         **/
+        Transform = 1 << 5,
+        /**
+         * The size changed, see sizeChanged
+         **/
+        Size = 1 << 6,
+        /**
+         * The Surface removed its content, see unmapped
+         **/
+        Unmapped = 1 << 7,
+        /**
+         * The Shadow changed, see shadowChanged
+         **/
+        Shadow = 1 << 8,
+        /**
+         * The Blur changed, see blurChanged
+         **/
+        Blur = 1 << 9,
+        /**
+         * The Contrast changed, see contrastChanged
+         **/
+        Contrast = 1 << 10,
+        /**
+         * The Slide changed, see slideOnShowHideChanged
+         **/
+        SlideOnShowHide = 1 << 11,
+        /**
+         * The stacking order of the sub-surfaces changed, see subSurfaceTreeChanged
+         **/
+        SubSurfaceTree = 1 << 12
+    };
+    Q_DECLARE_FLAGS(StateChanges, StateChange)
+
+    /**
+     * Sends the done event to the frame callbacks of this surface and its sub-surfaces
+     * and flushes the client.
+     *
+     * To notify all surfaces presented on an output prefer Display::frameRendered,
+     * which flushes each client only once.
+     **/
     void frameRendered(quint32 msec);
 
     QRegion damage() const;
+    /**
+     * The current damage region in buffer coordinates.
+     *
+     * This combines the damage the client sent in buffer coordinates with the damage
+     * sent in surface-local coordinates mapped through the buffer scale and transform.
+     * In contrast to damage it does not round outwards to full surface-local pixels,
+     * thus a compositor can use it to update exactly the changed parts of the buffer.
+     *
+     * @see damage
+     * @see scale
+     * @see transform
+     * @since 5.58
+     **/
+    QRegion bufferDamage() const;
     QRegion opaque() const;
     QRegion input() const;
     /**
@@ -119,6 +201,8 @@ public:
     QPoint offset() const;
     /**
      * The size of the Surface in global compositor space.
+     * This is the size of the BufferInterface divided by the scale and rotated
+     * according to the transform.
      * @see For buffer size use BufferInterface::size
      * from SurfaceInterface::buffer
      * @since 5.3
@@ -197,6 +281,29 @@ public:
      **/
     void resetTrackedDamage();
 
+    /**
+     * Sets the maximum number of rectangles the damage of this SurfaceInterface may consist of.
+     *
+     * Clients might damage a Surface with many small rectangles. Processing such a fragmented
+     * region is more expensive than repainting slightly more. If the damage of a commit or the
+     * tracked damage consists of more than @p count rectangles, it collapses to its bounding
+     * rectangle.
+     *
+     * A value of @c 0 disables the limit. The default is @c 64.
+     *
+     * @see maxDamageRects
+     * @see damage
+     * @see trackedDamage
+     * @since 5.58
+     **/
+    void setMaxDamageRects(int count);
+    /**
+     * @returns The maximum number of rectangles the damage may consist of, @c 0 for no limit.
+     * @see setMaxDamageRects
+     * @since 5.58
+     **/
+    int maxDamageRects() const;
+
     /**
      * Finds the SurfaceInterface at the given @p position in surface-local coordinates.
      * This can be either a descendant SurfaceInterface honoring the stacking order or
@@ -363,8 +470,22 @@ Q_SIGNALS:
      **/
     void committed();
 
+    /**
+     * Emitted once whenever new state got applied to the SurfaceInterface, after the
+     * individual xyzChanged signals. The @p changes contain all parts of the state which
+     * changed, this allows a compositor to handle a commit with one connection instead of
+     * connecting to each of the individual signals. The individual signals are still emitted,
+     * without a connected receiver emitting them is only a check for receivers.
+     *
+     * In contrast to committed this signal is not emitted for a commit of a synchronized
+     * sub-surface whose state gets cached until the parent surface is committed.
+     * @since 5.58
+     **/
+    void stateCommitted(KWayland::Server::SurfaceInterface::StateChanges changes);
+
 private:
     friend class CompositorInterface;
+    friend class Display;
     friend class SubSurfaceInterface;
     friend class ShadowManagerInterface;
     friend class BlurManagerInterface;
@@ -382,5 +503,7 @@ private:
 }
 
 Q_DECLARE_METATYPE(KWayland::Server::SurfaceInterface*)
+Q_DECLARE_METATYPE(KWayland::Server::SurfaceInterface::StateChanges)
+Q_DECLARE_OPERATORS_FOR_FLAGS(KWayland::Server::SurfaceInterface::StateChanges)
 
 #endif
@@ -39,6 +39,8 @@ class SurfaceInterface::Private : public Resource::Private
 public:
     struct State {
         QRegion damage = QRegion();
+        // damage in buffer coordinates as sent through damage_buffer
+        QRegion bufferDamage = QRegion();
         QRegion opaque = QRegion();
         QRegion input = QRegion();
         bool inputIsSet = false;
@@ -83,6 +85,12 @@ public:
 
     void commitSubSurface();
     void commit();
+    /**
+     * Sends the done event to the frame callbacks of this surface and all its sub-surfaces
+     * without flushing the client.
+     * @returns whether a callback was sent
+     **/
+    bool sendFrameCallbacks(quint32 msec);
 
     State current;
     State pending;
@@ -90,6 +98,25 @@ public:
     QPointer<SubSurfaceInterface> subSurface;
     QRegion trackedDamage;
 
+    /**
+     * A mapped surface of the sub-surface tree with its position relative to this surface.
+     **/
+    struct HitTestEntry {
+        SurfaceInterface *surface;
+        QPoint offset;
+        QSize size;
+    };
+    // the mapped surfaces of the sub-surface tree ordered from top to bottom
+    QVector<HitTestEntry> hitTestEntries;
+    bool hitTestEntriesValid = false;
+    void updateHitTestEntries();
+    void invalidateHitTestEntries();
+    static void collectHitTestEntries(SurfaceInterface *surface, const QPoint &offset, QVector<HitTestEntry> *entries);
+    // damage rects of the pending state, merged into the pending damage on commit
+    QVector<QRect> pendingDamageRects;
+    QVector<QRect> pendingBufferDamageRects;
+    int maxDamageRects = s_defaultMaxDamageRects;
+
     // workaround for https://bugreports.qt.io/browse/QTBUG-52192
     // A subsurface needs to be considered mapped even if it doesn't have a buffer attached
     // Otherwise Qt's sub-surfaces will never be visible and the client will freeze due to
@@ -102,6 +129,8 @@ public:
     QPointer<ConfinedPointerInterface> confinedPointer;
     QHash<OutputInterface*, QMetaObject::Connection> outputDestroyedConnections;
     QVector<IdleInhibitorInterface*> idleInhibitors;
+    // BufferInterfaces which have been attached to this surface and are still alive
+    QVector<BufferInterface*> knownBuffers;
 
     SurfaceInterface *dataProxy = nullptr;
 
@@ -112,8 +141,28 @@ private:
     SurfaceInterface *q_func() {
         return reinterpret_cast<SurfaceInterface *>(q);
     }
+    /**
+     * Applies the values set in @p source to @p target and resets @p source.
+     *
+     * Plain values and the storage of the regions, the children and the frame callbacks are
+     * moved instead of copied, so a commit only setting a buffer does not allocate for the
+     * state swap itself. Without scale and transform the damage and the buffer damage share
+     * their region data and the trackedDamage is only rebuilt if it does not cover the damage
+     * already. The following still allocates:
+     * @li any non empty QRegion holds heap data, the merged pending damage included
+     * @li combining damage in surface and buffer coordinates if both are set or a scale or
+     * transform applies, clipping damage exceeding the surface
+     * @li growing the trackedDamage
+     * @li appending frame callbacks if the target still has unprocessed ones
+     * @li copying the children list if the sub-surface stacking changed
+     **/
     void swapStates(State *source, State *target, bool emitChanged);
     void damage(const QRect &rect);
+    void damageBuffer(const QRect &rect);
+    void mergePendingDamage();
+    void mergeDamageRects(QVector<QRect> *rects, QRegion *region) const;
+    void limitDamage(QRegion *region) const;
+    void trackDamage(const QRegion &damage);
     void setScale(qint32 scale);
     void setTransform(OutputInterface::Transform transform);
     void addFrameCallback(uint32_t callback);
@@ -133,8 +182,12 @@ private:
     static void bufferTransformCallback(wl_client *client, wl_resource *resource, int32_t transform);
     // since version 3
     static void bufferScaleCallback(wl_client *client, wl_resource *resource, int32_t scale);
+    // since version 4
+    static void damageBufferCallback(wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height);
 
     static const struct wl_surface_interface s_interface;
+    static const int s_defaultMaxDamageRects;
+    static const int s_damageRectsBatch;
 };
 
 }
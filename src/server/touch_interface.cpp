@@ -73,7 +73,9 @@ void TouchInterface::cancel()
         return;
     }
     wl_touch_send_cancel(d->resource);
-    d->client->flush();
+    if (!d->seat->isInputFrame()) {
+        d->client->flushUrgent();
+    }
 }
 
 void TouchInterface::frame()
@@ -83,7 +85,9 @@ void TouchInterface::frame()
         return;
     }
     wl_touch_send_frame(d->resource);
-    d->client->flush();
+    if (!d->seat->isInputFrame()) {
+        d->client->flushUrgent();
+    }
 }
 
 void TouchInterface::move(qint32 id, const QPointF &localPos)
@@ -97,7 +101,9 @@ void TouchInterface::move(qint32 id, const QPointF &localPos)
         return;
     }
     wl_touch_send_motion(d->resource, d->seat->timestamp(), id, wl_fixed_from_double(localPos.x()), wl_fixed_from_double(localPos.y()));
-    d->client->flush();
+    if (!d->seat->isInputFrame()) {
+        d->client->flushUrgent();
+    }
 }
 
 void TouchInterface::up(qint32 id, quint32 serial)
@@ -107,7 +113,9 @@ void TouchInterface::up(qint32 id, quint32 serial)
         return;
     }
     wl_touch_send_up(d->resource, serial, d->seat->timestamp(), id);
-    d->client->flush();
+    if (!d->seat->isInputFrame()) {
+        d->client->flushUrgent();
+    }
 }
 
 void TouchInterface::down(qint32 id, quint32 serial, const QPointF &localPos)
@@ -118,7 +126,9 @@ void TouchInterface::down(qint32 id, quint32 serial, const QPointF &localPos)
     }
     wl_touch_send_down(d->resource, serial, d->seat->timestamp(), d->seat->focusedTouchSurface()->resource(),
                        id, wl_fixed_from_double(localPos.x()), wl_fixed_from_double(localPos.y()));
-    d->client->flush();
+    if (!d->seat->isInputFrame()) {
+        d->client->flushUrgent();
+    }
 }
 
 TouchInterface::Private *TouchInterface::d_func() const